@@ -0,0 +1,148 @@
+#include "bench.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#define BENCH_DEFAULT_THREADS   4
+#define BENCH_SAMPLE_CAP        (1UL << 18)
+
+//=============================================================================
+// Harness
+//
+// Usage: bench_malloc <workload> [label] [threads]
+//
+// Runs one workload and prints a single line with its throughput, the p50/p99
+// latency of individual malloc/free/realloc calls and the peak RSS of the process.
+// The allocator is whatever the binary resolves malloc to, so the same binary is
+// measured against glibc and, with LD_PRELOAD, against libft_malloc.so. Peak RSS is
+// process-wide, hence one workload per process.
+//=============================================================================
+
+/**
+ * @brief Starts 'nthreads' threads running 'fn' on their t_bench_thread and joins them.
+ */
+void bench_spawn(t_bench_thread *threads, int nthreads, void *(*fn)(void *))
+{
+    pthread_t tids[BENCH_MAX_THREADS];
+
+    for (int i = 0; i < nthreads; i++)
+    {
+        if (pthread_create(&tids[i], NULL, fn, &threads[i]) != 0)
+        {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(tids[i], NULL);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Gathers every thread's samples into one mapped buffer and sorts them.
+ *
+ * @return Number of samples in *out (0 if there are none or the mapping failed).
+ */
+static size_t merge_samples(t_bench_thread *threads, int nthreads, uint64_t **out)
+{
+    size_t total = 0;
+    size_t pos = 0;
+    uint64_t *all;
+
+    for (int i = 0; i < nthreads; i++)
+        total += threads[i].nsamples;
+    if (total == 0)
+        return 0;
+    all = mmap(NULL, total * sizeof(uint64_t), PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (all == MAP_FAILED)
+        return 0;
+    for (int i = 0; i < nthreads; i++)
+    {
+        memcpy(all + pos, threads[i].samples, threads[i].nsamples * sizeof(uint64_t));
+        pos += threads[i].nsamples;
+    }
+    qsort(all, total, sizeof(uint64_t), cmp_u64);
+    *out = all;
+    return total;
+}
+
+static const t_workload *find_workload(const char *name)
+{
+    for (const t_workload *w = g_workloads; w->name; w++)
+    {
+        if (strcmp(w->name, name) == 0)
+            return w;
+    }
+    return NULL;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s <workload> [label] [threads]\nworkloads:\n", prog);
+    for (const t_workload *w = g_workloads; w->name; w++)
+        fprintf(stderr, "  %-10s %s\n", w->name, w->desc);
+}
+
+int main(int argc, char **argv)
+{
+    static t_bench_thread threads[BENCH_MAX_THREADS];
+    const t_workload *workload;
+    const char *label = argc > 2 ? argv[2] : "default";
+    int nthreads = argc > 3 ? atoi(argv[3]) : BENCH_DEFAULT_THREADS;
+    uint64_t ops = 0;
+    uint64_t *samples = NULL;
+    size_t nsamples;
+    struct rusage usage_info;
+    uint64_t start;
+    double elapsed;
+
+    workload = argc > 1 ? find_workload(argv[1]) : NULL;
+    if (!workload || nthreads < 1 || nthreads > BENCH_MAX_THREADS)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    // Every slot gets a (lazily backed) sample buffer: workloads may round the
+    // thread count up.
+    for (int i = 0; i < BENCH_MAX_THREADS; i++)
+    {
+        threads[i].id = i;
+        threads[i].seed = 1234 + i;
+        threads[i].cap = BENCH_SAMPLE_CAP;
+        threads[i].samples = mmap(NULL, BENCH_SAMPLE_CAP * sizeof(uint64_t),
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (threads[i].samples == MAP_FAILED)
+        {
+            perror("mmap");
+            return 1;
+        }
+    }
+
+    for (int i = 0; i < BENCH_MAX_THREADS; i++)
+        threads[i].nthreads = nthreads;
+    start = bench_now_ns();
+    nthreads = workload->run(threads, nthreads);
+    elapsed = (bench_now_ns() - start) / 1e9;
+
+    for (int i = 0; i < nthreads; i++)
+        ops += threads[i].ops;
+    nsamples = merge_samples(threads, nthreads, &samples);
+    getrusage(RUSAGE_SELF, &usage_info);
+    printf("%-10s %-10s threads=%-2d ops/sec=%12.0f p50=%6lluns p99=%7lluns peak_rss=%8ldKB\n",
+           workload->name, label, nthreads, ops / elapsed,
+           nsamples ? (unsigned long long)samples[nsamples / 2] : 0ULL,
+           nsamples ? (unsigned long long)samples[nsamples * 99 / 100] : 0ULL,
+           usage_info.ru_maxrss);
+    return 0;
+}
@@ -0,0 +1,120 @@
+#ifndef BENCH_H
+# define BENCH_H
+
+# include <stddef.h>
+# include <stdint.h>
+# include <stdlib.h>
+# include <time.h>
+
+// One operation out of BENCH_SAMPLE_EVERY is timed individually for the latency
+// percentiles; the others only count towards ops/sec.
+#define BENCH_SAMPLE_EVERY  8
+
+#define BENCH_MAX_THREADS   64
+
+//=============================================================================
+// Data Structures
+//=============================================================================
+
+/**
+ * @brief State of one benchmark thread.
+ *
+ * Latency samples go to a buffer mapped before the run, so recording them never
+ * calls the allocator under test.
+ */
+typedef struct s_bench_thread {
+    int             id;
+    int             nthreads;
+    unsigned int    seed;
+    uint64_t        ops;
+    uint64_t        *samples;
+    size_t          nsamples;
+    size_t          cap;
+    void            *shared;
+} t_bench_thread;
+
+/**
+ * @brief A named workload. 'run' starts and joins its own threads and returns how
+ * many it used (a workload may round the requested count up).
+ */
+typedef struct s_workload {
+    const char      *name;
+    const char      *desc;
+    int             (*run)(t_bench_thread *threads, int nthreads);
+} t_workload;
+
+extern const t_workload g_workloads[];
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+void bench_spawn(t_bench_thread *threads, int nthreads, void *(*fn)(void *));
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief malloc() that counts the operation and times one call out of
+ * BENCH_SAMPLE_EVERY.
+ */
+static inline void *bench_malloc(t_bench_thread *t, size_t size)
+{
+    uint64_t start;
+    void *ptr;
+
+    if (t->ops++ % BENCH_SAMPLE_EVERY || t->nsamples == t->cap)
+        return malloc(size);
+    start = bench_now_ns();
+    ptr = malloc(size);
+    t->samples[t->nsamples++] = bench_now_ns() - start;
+    return ptr;
+}
+
+/**
+ * @brief free() counterpart of bench_malloc().
+ */
+static inline void bench_free(t_bench_thread *t, void *ptr)
+{
+    uint64_t start;
+
+    if (t->ops++ % BENCH_SAMPLE_EVERY || t->nsamples == t->cap)
+    {
+        free(ptr);
+        return;
+    }
+    start = bench_now_ns();
+    free(ptr);
+    t->samples[t->nsamples++] = bench_now_ns() - start;
+}
+
+/**
+ * @brief realloc() counterpart of bench_malloc().
+ */
+static inline void *bench_realloc(t_bench_thread *t, void *ptr, size_t size)
+{
+    uint64_t start;
+
+    if (t->ops++ % BENCH_SAMPLE_EVERY || t->nsamples == t->cap)
+        return realloc(ptr, size);
+    start = bench_now_ns();
+    ptr = realloc(ptr, size);
+    t->samples[t->nsamples++] = bench_now_ns() - start;
+    return ptr;
+}
+
+/**
+ * @brief Touches the first byte so the allocation cannot be optimized out.
+ */
+static inline void bench_touch(void *ptr, size_t i)
+{
+    if (ptr)
+        *(volatile char *)ptr = (char)i;
+}
+
+#endif
@@ -0,0 +1,483 @@
+#include "bench.h"
+#include <fcntl.h>
+#include <malloc.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define LARSON_SLOTS        1024
+#define LARSON_ROUNDS       8
+#define LARSON_OPS          25000
+#define LARSON_MIN_SIZE     8
+#define LARSON_MAX_SIZE     512
+
+#define CHURN_SLOTS         4096
+#define CHURN_OPS           200000
+#define CHURN_MAX_SHIFT     16
+
+#define HOTLOOP_OPS         500000
+#define HOTLOOP_SIZE        64
+
+#define REALLOC_ROUNDS      64
+#define REALLOC_MAX_SIZE    (4UL << 20)
+
+#define XFREE_OBJS          200000
+#define XFREE_RING          1024
+#define XFREE_MAX_SIZE      1024
+
+#define OVERHEAD_OBJS       200000
+#define OVERHEAD_MAX_SIZE   1024
+
+#define CHASE_NODES         (1 << 18)
+#define CHASE_NODE_SIZE     256
+#define CHASE_HOPS          (1 << 23)
+
+#define FILL_MAX            8192
+#define FILL_SIZE           200
+
+//=============================================================================
+// larson: server-style churn where objects outlive the thread that allocated them.
+// Each round every thread replaces random objects in one slot array; between
+// rounds the arrays rotate to the next thread, so most frees hit memory that
+// another thread allocated.
+//=============================================================================
+
+typedef struct s_larson {
+    void            *slots[BENCH_MAX_THREADS][LARSON_SLOTS];
+    int             round;
+} t_larson;
+
+static size_t larson_size(unsigned int *seed)
+{
+    return LARSON_MIN_SIZE + rand_r(seed) % (LARSON_MAX_SIZE - LARSON_MIN_SIZE + 1);
+}
+
+static void *larson_thread(void *arg)
+{
+    t_bench_thread *t = arg;
+    t_larson *shared = t->shared;
+    void **slots = shared->slots[(t->id + shared->round) % t->nthreads];
+
+    for (int i = 0; i < LARSON_OPS; i++)
+    {
+        int idx = rand_r(&t->seed) % LARSON_SLOTS;
+
+        bench_free(t, slots[idx]);
+        slots[idx] = bench_malloc(t, larson_size(&t->seed));
+        bench_touch(slots[idx], i);
+    }
+    return NULL;
+}
+
+static int run_larson(t_bench_thread *threads, int nthreads)
+{
+    static t_larson shared;
+    unsigned int seed = 42;
+
+    for (int i = 0; i < nthreads; i++)
+    {
+        threads[i].shared = &shared;
+        for (int j = 0; j < LARSON_SLOTS; j++)
+            shared.slots[i][j] = malloc(larson_size(&seed));
+    }
+    for (shared.round = 0; shared.round < LARSON_ROUNDS; shared.round++)
+        bench_spawn(threads, nthreads, larson_thread);
+    for (int i = 0; i < nthreads; i++)
+    {
+        for (int j = 0; j < LARSON_SLOTS; j++)
+            free(shared.slots[i][j]);
+    }
+    return nthreads;
+}
+
+//=============================================================================
+// churn: random sizes, log-uniform from 1 byte to 64 KiB, over a large working set
+// per thread, so every size class and the LARGE path get exercised.
+//=============================================================================
+
+static void *churn_thread(void *arg)
+{
+    t_bench_thread *t = arg;
+    void **slots = calloc(CHURN_SLOTS, sizeof(void *));
+
+    for (int i = 0; i < CHURN_OPS; i++)
+    {
+        int idx = rand_r(&t->seed) % CHURN_SLOTS;
+        size_t size = 1 + rand_r(&t->seed) % (1UL << (rand_r(&t->seed) % CHURN_MAX_SHIFT + 1));
+
+        bench_free(t, slots[idx]);
+        slots[idx] = bench_malloc(t, size);
+        bench_touch(slots[idx], i);
+    }
+    for (int i = 0; i < CHURN_SLOTS; i++)
+        free(slots[i]);
+    free(slots);
+    return NULL;
+}
+
+static int run_churn(t_bench_thread *threads, int nthreads)
+{
+    bench_spawn(threads, nthreads, churn_thread);
+    return nthreads;
+}
+
+//=============================================================================
+// hotloop: malloc and immediately free one fixed-size object, the best case for
+// any per-thread cache.
+//=============================================================================
+
+static void *hotloop_thread(void *arg)
+{
+    t_bench_thread *t = arg;
+
+    for (int i = 0; i < HOTLOOP_OPS; i++)
+    {
+        void *ptr = bench_malloc(t, HOTLOOP_SIZE);
+
+        bench_touch(ptr, i);
+        bench_free(t, ptr);
+    }
+    return NULL;
+}
+
+static int run_hotloop(t_bench_thread *threads, int nthreads)
+{
+    bench_spawn(threads, nthreads, hotloop_thread);
+    return nthreads;
+}
+
+//=============================================================================
+// realloc: grow a buffer by about 1/8 at a time from 8 bytes to 4 MiB, as a
+// string builder or vector would, writing the new tail each time.
+//=============================================================================
+
+static void *realloc_thread(void *arg)
+{
+    t_bench_thread *t = arg;
+
+    for (int round = 0; round < REALLOC_ROUNDS; round++)
+    {
+        char *buf = NULL;
+        size_t size = 8;
+        size_t old = 0;
+
+        while (size <= REALLOC_MAX_SIZE)
+        {
+            char *grown = bench_realloc(t, buf, size);
+
+            if (!grown)
+                break;
+            buf = grown;
+            memset(buf + old, (char)round, size - old);
+            old = size;
+            size += size / 8 + 16;
+        }
+        bench_free(t, buf);
+    }
+    return NULL;
+}
+
+static int run_realloc(t_bench_thread *threads, int nthreads)
+{
+    bench_spawn(threads, nthreads, realloc_thread);
+    return nthreads;
+}
+
+//=============================================================================
+// xfree: producer/consumer pairs. Even threads allocate and push objects through a
+// single-producer single-consumer ring; odd threads pop and free them, so every
+// free is remote. An odd thread count is rounded up to pair the last producer.
+//=============================================================================
+
+typedef struct s_ring {
+    void            *items[XFREE_RING];
+    size_t          head;
+    size_t          tail;
+} t_ring;
+
+static void *xfree_producer(t_bench_thread *t, t_ring *ring)
+{
+    for (int i = 0; i < XFREE_OBJS; i++)
+    {
+        void *ptr = bench_malloc(t, 1 + rand_r(&t->seed) % XFREE_MAX_SIZE);
+        size_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+        bench_touch(ptr, i);
+        while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == XFREE_RING)
+            sched_yield();
+        ring->items[head % XFREE_RING] = ptr;
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void *xfree_consumer(t_bench_thread *t, t_ring *ring)
+{
+    for (int i = 0; i < XFREE_OBJS; i++)
+    {
+        size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+        while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+            sched_yield();
+        bench_free(t, ring->items[tail % XFREE_RING]);
+        __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void *xfree_thread(void *arg)
+{
+    t_bench_thread *t = arg;
+    t_ring *ring = (t_ring *)t->shared + t->id / 2;
+
+    if (t->id % 2 == 0)
+        return xfree_producer(t, ring);
+    return xfree_consumer(t, ring);
+}
+
+static int run_xfree(t_bench_thread *threads, int nthreads)
+{
+    static t_ring rings[BENCH_MAX_THREADS / 2];
+
+    nthreads += nthreads % 2;
+    for (int i = 0; i < nthreads; i++)
+    {
+        threads[i].nthreads = nthreads;
+        threads[i].shared = rings;
+    }
+    bench_spawn(threads, nthreads, xfree_thread);
+    return nthreads;
+}
+
+//=============================================================================
+// overhead: bytes the allocator spends per live allocation. A single thread
+// allocates and fills a large set of objects of random TINY/SMALL sizes and keeps
+// them all live; the resident set growth is split into requested bytes, slack
+// (usable size beyond the request) and the rest, which is metadata: headers,
+// bitmaps and partially used pages.
+//=============================================================================
+
+/**
+ * @brief Resident set size in bytes, read from /proc without allocating.
+ */
+static size_t resident_bytes(void)
+{
+    char buf[128];
+    size_t pages = 0;
+    char *p;
+    ssize_t len;
+    int fd = open("/proc/self/statm", O_RDONLY);
+
+    if (fd < 0)
+        return 0;
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+    p = strchr(buf, ' ');
+    while (p && *++p >= '0' && *p <= '9')
+        pages = pages * 10 + (*p - '0');
+    return pages * sysconf(_SC_PAGESIZE);
+}
+
+static int run_overhead(t_bench_thread *threads, int nthreads)
+{
+    static void *objs[OVERHEAD_OBJS];
+    t_bench_thread *t = &threads[0];
+    size_t requested = 0;
+    size_t usable = 0;
+    size_t before;
+    size_t grown;
+
+    (void)nthreads;
+    before = resident_bytes();
+    for (int i = 0; i < OVERHEAD_OBJS; i++)
+    {
+        size_t size = 1 + rand_r(&t->seed) % OVERHEAD_MAX_SIZE;
+
+        objs[i] = bench_malloc(t, size);
+        if (!objs[i])
+            break;
+        memset(objs[i], i, size);
+        requested += size;
+        usable += malloc_usable_size(objs[i]);
+    }
+    grown = resident_bytes() - before;
+    printf("%-10s objs=%d requested/alloc=%.1f slack/alloc=%.1f metadata/alloc=%.1f\n",
+           "overhead", OVERHEAD_OBJS, (double)requested / OVERHEAD_OBJS,
+           (double)(usable - requested) / OVERHEAD_OBJS,
+           ((double)grown - (double)usable) / OVERHEAD_OBJS);
+    for (int i = 0; i < OVERHEAD_OBJS; i++)
+        bench_free(t, objs[i]);
+    return 1;
+}
+
+//=============================================================================
+// chase: pointer chasing through a random cycle of SMALL nodes, about 70 MiB of
+// them, far beyond what the dTLB covers with 4 KiB pages. Every hop is a dependent
+// load to a random page, so the run time is dominated by cache and TLB misses;
+// compare FT_MALLOC_CONF=thp:1 against the default. dTLB load misses are read
+// from a perf counter when the kernel lets us open one, and the huge pages backing
+// the heap from /proc/self/smaps_rollup.
+//=============================================================================
+
+/**
+ * @brief Opens a counter of the calling thread's user-space dTLB load misses.
+ *
+ * @return The perf event fd, or -1 if perf events are unavailable.
+ */
+static int dtlb_counter(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                  | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * @brief Anonymous memory backed by transparent huge pages, in KiB, read from /proc
+ * without allocating.
+ */
+static long huge_kb(void)
+{
+    static const char key[] = "AnonHugePages:";
+    char buf[2048];
+    long kb = 0;
+    char *p;
+    ssize_t len;
+    int fd = open("/proc/self/smaps_rollup", O_RDONLY);
+
+    if (fd < 0)
+        return -1;
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return -1;
+    buf[len] = '\0';
+    p = strstr(buf, key);
+    if (!p)
+        return -1;
+    for (p += sizeof(key) - 1; *p == ' '; p++)
+        ;
+    while (*p >= '0' && *p <= '9')
+        kb = kb * 10 + (*p++ - '0');
+    return kb;
+}
+
+static int run_chase(t_bench_thread *threads, int nthreads)
+{
+    static void *nodes[CHASE_NODES];
+    t_bench_thread *t = &threads[0];
+    int fd = dtlb_counter();
+    long long misses = -1;
+    void **p;
+    uint64_t start;
+    uint64_t elapsed;
+
+    (void)nthreads;
+    for (int i = 0; i < CHASE_NODES; i++)
+    {
+        nodes[i] = bench_malloc(t, CHASE_NODE_SIZE);
+        if (!nodes[i])
+            return 1;
+    }
+    for (int i = CHASE_NODES - 1; i > 0; i--)
+    {
+        int j = rand_r(&t->seed) % (i + 1);
+        void *tmp = nodes[i];
+
+        nodes[i] = nodes[j];
+        nodes[j] = tmp;
+    }
+    for (int i = 0; i < CHASE_NODES; i++)
+        *(void **)nodes[i] = nodes[(i + 1) % CHASE_NODES];
+    p = nodes[0];
+    if (fd >= 0)
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    start = bench_now_ns();
+    for (int i = 0; i < CHASE_HOPS; i++)
+        p = *p;
+    elapsed = bench_now_ns() - start;
+    if (fd >= 0)
+    {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &misses, sizeof(misses)) != sizeof(misses))
+            misses = -1;
+        close(fd);
+    }
+    printf("%-10s nodes=%d ns/hop=%.1f dtlb_misses/hop=", "chase", CHASE_NODES,
+           (double)elapsed / CHASE_HOPS);
+    if (misses >= 0)
+        printf("%.3f", (double)misses / CHASE_HOPS);
+    else
+        printf("n/a");
+    printf(" huge_pages=%ldKB\n", huge_kb());
+    // The walk depends on every load, and checking where it ended keeps it alive.
+    if (p != nodes[CHASE_HOPS % CHASE_NODES])
+        fprintf(stderr, "chase: the cycle is broken\n");
+    for (int i = 0; i < CHASE_NODES; i++)
+        bench_free(t, nodes[i]);
+    return 1;
+}
+
+//=============================================================================
+// fill: free() latency as a SMALL zone fills up. For each fill level a single
+// thread allocates that many adjacent blocks, frees every other one (no free
+// neighbour to merge with), then the rest (each merging with both neighbours). The
+// time per free should stay flat as the fill grows. 'make bench' runs it with
+// FT_MALLOC_TCACHE=0, so the zone path is timed rather than the thread cache.
+//=============================================================================
+
+static int run_fill(t_bench_thread *threads, int nthreads)
+{
+    static void *blocks[FILL_MAX];
+    t_bench_thread *t = &threads[0];
+    uint64_t start;
+    uint64_t mid;
+    uint64_t end;
+
+    (void)nthreads;
+    for (int fill = 64; fill <= FILL_MAX; fill *= 2)
+    {
+        for (int i = 0; i < fill; i++)
+        {
+            blocks[i] = bench_malloc(t, FILL_SIZE);
+            bench_touch(blocks[i], i);
+        }
+        start = bench_now_ns();
+        for (int i = 0; i < fill; i += 2)
+            free(blocks[i]);
+        mid = bench_now_ns();
+        for (int i = 1; i < fill; i += 2)
+            free(blocks[i]);
+        end = bench_now_ns();
+        t->ops += fill;
+        printf("%-10s live=%-5d isolated=%6.1fns/free merging=%6.1fns/free\n", "fill", fill,
+               (double)(mid - start) / (fill / 2), (double)(end - mid) / (fill / 2));
+    }
+    return 1;
+}
+
+const t_workload g_workloads[] = {
+    {"larson", "objects rotate between threads every round (Larson)", run_larson},
+    {"churn", "random log-uniform sizes up to 64 KiB", run_churn},
+    {"hotloop", "malloc/free of one 64-byte object in a tight loop", run_hotloop},
+    {"realloc", "buffers grown by 1/8 steps from 8 bytes to 4 MiB", run_realloc},
+    {"xfree", "producer threads allocate, consumer threads free", run_xfree},
+    {"overhead", "metadata bytes per live allocation (single thread)", run_overhead},
+    {"chase", "pointer chasing through 256-byte nodes (single thread)", run_chase},
+    {"fill", "free() latency of 200-byte blocks as a zone fills (single thread)", run_fill},
+    {NULL, NULL, NULL}
+};
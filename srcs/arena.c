@@ -0,0 +1,188 @@
+#include "libft_malloc.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+// Attempts of arena_try_lock() before it gives up, yielding between them.
+#define ARENA_TRY_LOCK_ATTEMPTS 1000
+
+t_arena g_arenas[ARENA_MAX];
+
+static size_t g_next_arena;
+static pthread_once_t g_arena_once = PTHREAD_ONCE_INIT;
+static __thread t_arena *g_thread_arena __attribute__((tls_model("initial-exec")));
+
+/**
+ * @brief One-time setup: loads the configuration and initializes every arena lock
+ * (and, in Valgrind builds, every arena's mempool).
+ */
+static void arena_global_init(void)
+{
+    config_init();
+    vg_init();
+    for (size_t i = 0; i < ARENA_MAX; i++)
+        pthread_mutex_init(&g_arenas[i].mutex, NULL);
+}
+
+/**
+ * @brief Number of arenas in use (FT_MALLOC_ARENAS); arenas past this index are
+ * never handed out.
+ */
+size_t arena_count(void)
+{
+    pthread_once(&g_arena_once, arena_global_init);
+    return g_config.arenas;
+}
+
+/**
+ * @brief Returns the calling thread's arena, binding the thread on first use.
+ *
+ * Threads are spread over the arenas round-robin in the order they first allocate,
+ * so up to arena_count() threads never contend on a lock.
+ *
+ * @return Pointer to the arena the calling thread allocates from.
+ */
+t_arena *arena_get(void)
+{
+    size_t index;
+
+    if (g_thread_arena)
+        return g_thread_arena;
+    index = __atomic_fetch_add(&g_next_arena, 1, __ATOMIC_RELAXED) % arena_count();
+    g_thread_arena = &g_arenas[index];
+    return g_thread_arena;
+}
+
+/**
+ * @brief Hands freed allocations to an arena without taking its lock.
+ *
+ * The chain [first .. last], linked through the first word of each allocation,
+ * is pushed onto the arena's remote-free stack with a single successful CAS. It
+ * is returned to the zones by the next thread that locks the arena through
+ * arena_lock() (normally the owner, on its next allocation).
+ *
+ * @param arena Arena owning every allocation of the chain.
+ * @param first First allocation of the chain.
+ * @param last Last allocation of the chain; its link is overwritten.
+ */
+void arena_remote_free(t_arena *arena, void *first, void *last)
+{
+    void *head = __atomic_load_n(&arena->remote_frees, __ATOMIC_RELAXED);
+
+    vg_defined(last, sizeof(void *));
+    do
+        *(void **)last = head;
+    while (!__atomic_compare_exchange_n(&arena->remote_frees, &head, first, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Returns every allocation pushed by arena_remote_free() to its zone.
+ * Caller holds the arena lock.
+ *
+ * The whole stack is detached with one exchange, so remote threads keep pushing
+ * onto an empty stack while it is drained.
+ *
+ * @param arena Arena to drain.
+ */
+void arena_drain(t_arena *arena)
+{
+    void *ptr;
+    void *next;
+
+    if (!__atomic_load_n(&arena->remote_frees, __ATOMIC_RELAXED))
+        return;
+    ptr = __atomic_exchange_n(&arena->remote_frees, NULL, __ATOMIC_ACQUIRE);
+    while (ptr)
+    {
+        next = *(void **)ptr;
+        release_ptr(get_zone_for_ptr(ptr), ptr);
+        ptr = next;
+    }
+}
+
+/**
+ * @brief Locks the calling thread's arena for an allocation, after draining the
+ * frees other threads left for it.
+ *
+ * @return The locked arena.
+ */
+t_arena *arena_lock(void)
+{
+    t_arena *arena = arena_get();
+
+    pthread_mutex_lock(&arena->mutex);
+    arena_drain(arena);
+    return arena;
+}
+
+/**
+ * @brief Locks an arena for a report, giving up instead of blocking forever.
+ *
+ * Reports may run in a signal handler that interrupted the lock holder, which would
+ * never get to release it; so the lock is only tried, yielding between attempts.
+ *
+ * @return 0 with the arena locked, -1 if its lock stayed taken.
+ */
+int arena_try_lock(t_arena *arena)
+{
+    for (int i = 0; i < ARENA_TRY_LOCK_ATTEMPTS; i++)
+    {
+        if (pthread_mutex_trylock(&arena->mutex) == 0)
+            return 0;
+        sched_yield();
+    }
+    return -1;
+}
+
+/**
+ * @brief Locks every arena in index order with arena_try_lock(), for reports that
+ * need the whole heap to stand still.
+ *
+ * @param drain Non-zero to apply pending remote frees, so they do not show as live.
+ * @return Bit i set if arena i is locked; arenas whose lock stayed taken are left out.
+ */
+uint64_t arena_lock_all(int drain)
+{
+    uint64_t locked = 0;
+
+    for (size_t i = 0; i < arena_count(); i++)
+    {
+        if (arena_try_lock(&g_arenas[i]) != 0)
+            continue;
+        if (drain)
+            arena_drain(&g_arenas[i]);
+        locked |= 1ULL << i;
+    }
+    return locked;
+}
+
+/**
+ * @brief Releases the locks taken by arena_lock_all(), in reverse order.
+ */
+void arena_unlock_all(uint64_t locked)
+{
+    for (size_t i = arena_count(); i-- > 0;)
+    {
+        if (locked & (1ULL << i))
+            pthread_mutex_unlock(&g_arenas[i].mutex);
+    }
+}
+
+/**
+ * @brief Fork handler of the arena locks (see fork_mutex()): unlike reports, fork()
+ * waits for every arena, taken in index order and given back in reverse.
+ */
+void arena_fork(int phase)
+{
+    size_t count = arena_count();
+
+    if (phase == FORK_PREPARE)
+    {
+        for (size_t i = 0; i < count; i++)
+            fork_mutex(&g_arenas[i].mutex, phase);
+        return;
+    }
+    for (size_t i = count; i-- > 0;)
+        fork_mutex(&g_arenas[i].mutex, phase);
+}
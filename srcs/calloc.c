@@ -0,0 +1,53 @@
+#include "libft_malloc.h"
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+/**
+ * @brief Allocates zero-initialized memory for an array of 'nmemb' elements of
+ * 'size' bytes each.
+ *
+ * LARGE allocations always live in a freshly mmap'd zone, whose pages the kernel
+ * already zeroed, so they skip the memset and are never touched. TINY and SMALL
+ * allocations may reuse freed memory and are cleared explicitly. The allocation
+ * goes through the internal paths rather than malloc(), which the compiler would
+ * otherwise fold with the memset back into a call to calloc().
+ *
+ * @param nmemb Number of elements.
+ * @param size Size of each element in bytes.
+ * @return Pointer to the allocated memory, or NULL if the product overflows or
+ *         allocation fails (errno is set to ENOMEM).
+ */
+void *calloc(size_t nmemb, size_t size)
+{
+    t_arena *arena;
+    size_t total;
+    size_t aligned_size;
+    void *ptr;
+
+    CONFIG_ENSURE();
+    if (__builtin_mul_overflow(nmemb, size, &total) || total > REQUEST_MAX)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (total == 0)
+        total = 1;
+    aligned_size = REQUEST_SIZE(total);
+    stats_count(STAT_ALLOCS + SIZE_TYPE(aligned_size));
+    ptr = tcache_malloc(aligned_size);
+    if (!ptr)
+    {
+        arena = arena_lock();
+        ptr = alloc_ptr(arena, aligned_size);
+        pthread_mutex_unlock(&arena->mutex);
+    }
+    if (ptr && prof_tick(aligned_size))
+        prof_sample(ptr, aligned_size);
+    vg_alloc(ptr, aligned_size > SMALL_PAYLOAD_MAX);
+    if (!ptr)
+        errno = ENOMEM;
+    else if (aligned_size <= SMALL_PAYLOAD_MAX)
+        memset(ptr, 0, aligned_size);
+    return ptr;
+}
@@ -0,0 +1,267 @@
+#define _GNU_SOURCE
+#include "libft_malloc.h"
+#include <sched.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/auxv.h>
+#include <pthread.h>
+
+t_config g_config;
+
+static pthread_once_t g_config_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief FT_MALLOC_CONF options, in the order of their slot in the values array.
+ */
+enum e_conf_option {
+    CONF_TINY_MAX,
+    CONF_SMALL_MAX,
+    CONF_TINY_ZONE_PAGES,
+    CONF_SMALL_ZONE_PAGES,
+    CONF_RETAIN,
+    CONF_ARENAS,
+    CONF_TCACHE,
+    CONF_SMALL_ALIGN,
+    CONF_THP,
+    CONF_PROF_SAMPLE,
+    CONF_QUARANTINE,
+    CONF_LEAK_REPORT,
+    CONF_OPTIONS
+};
+
+static const char *const g_conf_names[CONF_OPTIONS] = {
+    "tiny_max", "small_max", "tiny_zone_pages", "small_zone_pages",
+    "retain", "arenas", "tcache", "small_align", "thp", "prof_sample",
+    "quarantine", "leak_report"
+};
+
+/**
+ * @brief Reads an integer environment variable.
+ *
+ * @return The value, or 'fallback' if the variable is unset.
+ */
+static long env_long(const char *name, long fallback)
+{
+    const char *env = getenv(name);
+
+    return env ? atol(env) : fallback;
+}
+
+/**
+ * @brief Reports an FT_MALLOC_CONF entry that was ignored, straight to stderr.
+ */
+static void conf_warn(const char *entry, size_t len)
+{
+    static const char prefix[] = "ft_malloc: ignoring FT_MALLOC_CONF entry '";
+
+    write(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+    write(STDERR_FILENO, entry, len);
+    write(STDERR_FILENO, "'\n", 2);
+}
+
+/**
+ * @brief Applies one "name:value" entry of FT_MALLOC_CONF.
+ *
+ * @return 0 on success, -1 if the name is unknown or the value is not a decimal
+ *         number.
+ */
+static int conf_entry(const char *entry, size_t len, long *values)
+{
+    const char *colon = memchr(entry, ':', len);
+    const char *digit;
+    long value = 0;
+
+    if (!colon || colon + 1 == entry + len)
+        return -1;
+    for (digit = colon + 1; digit < entry + len; digit++)
+    {
+        if (*digit < '0' || *digit > '9' || value > (LONG_MAX - 9) / 10)
+            return -1;
+        value = value * 10 + (*digit - '0');
+    }
+    for (int i = 0; i < CONF_OPTIONS; i++)
+    {
+        if (strlen(g_conf_names[i]) == (size_t)(colon - entry)
+            && memcmp(g_conf_names[i], entry, colon - entry) == 0)
+        {
+            values[i] = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Parses FT_MALLOC_CONF, a comma-separated list of "name:value" entries such
+ * as "tiny_max:128,small_max:2048,arenas:4", in place: nothing is allocated.
+ * Malformed and unknown entries are reported and skipped.
+ */
+static void conf_parse(const char *conf, long *values)
+{
+    const char *end;
+
+    while (*conf)
+    {
+        end = strchr(conf, ',');
+        if (!end)
+            end = conf + strlen(conf);
+        if (end > conf && conf_entry(conf, end - conf, values) != 0)
+            conf_warn(conf, end - conf);
+        conf = *end ? end + 1 : end;
+    }
+}
+
+static long clamp(long value, long min, long max)
+{
+    if (value < min)
+        return min;
+    return value > max ? max : value;
+}
+
+/**
+ * @brief Fills the SMALL bin table, indexed by (size - 1) / ALIGNMENT: one class per
+ * ALIGNMENT bytes up to 64, then four geometric classes per doubling.
+ *
+ * Class boundaries are multiples of ALIGNMENT, so every size of a table slot maps
+ * to the same bin.
+ */
+static void config_bins(t_config *config)
+{
+    size_t size;
+    size_t log;
+
+    for (size_t i = 0; i < SMALL_BIN_SLOTS; i++)
+    {
+        size = (i + 1) * ALIGNMENT;
+        if (size <= 64)
+        {
+            config->small_bins[i] = i;
+            continue;
+        }
+        log = 63 - __builtin_clzl(size - 1);
+        config->small_bins[i] = 4 + ((log - 6) << 2) + (((size - 1) >> (log - 2)) & 3);
+    }
+}
+
+/**
+ * @brief Draws the secret freed allocations are tagged with (and hardened block
+ * headers are sealed with), from the random bytes the kernel hands every process.
+ */
+static uint64_t config_canary(void)
+{
+    const uint64_t *random = (const uint64_t *)getauxval(AT_RANDOM);
+    uint64_t seed = (uintptr_t)&seed;
+
+    if (random)
+        seed ^= random[0] * 0x9E3779B97F4A7C15ULL ^ random[1];
+    return seed | 1;
+}
+
+/**
+ * @brief Computes the allocator geometry and reads the tunables, once.
+ *
+ * Each tunable starts from its compile-time default, is overridden by its own
+ * environment variable when there is one, then by FT_MALLOC_CONF:
+ * - tiny_max, small_max: largest TINY and SMALL requests, rounded up to ALIGNMENT,
+ *   up to TINY_MAX_LIMIT and SMALL_MAX_LIMIT.
+ * - tiny_zone_pages, small_zone_pages: zone sizes in pages; a SMALL zone always
+ *   holds at least eight of its largest blocks.
+ * - retain (FT_MALLOC_RETAIN): empty zones of each type kept per arena (default 1).
+ * - arenas (FT_MALLOC_ARENAS): number of arenas (default: the CPUs the process may
+ *   run on, read with sched_getaffinity() into a stack buffer).
+ * - tcache: entries per thread-cache bin, 0 disables the caches (as does
+ *   FT_MALLOC_TCACHE=0). Hardened builds always disable them: an allocation parked
+ *   in another thread's cache would pass for live to a second free().
+ * - small_align (FT_MALLOC_SMALL_ALIGN): SMALL payload alignment, a power of two
+ *   from ALIGNMENT (the default) to 4096; 64 keeps SMALL blocks off each other's
+ *   cache lines.
+ * - thp: 0 (the default) maps zones with plain 4 KiB pages; 1 rounds SMALL zones up
+ *   to HUGE_PAGE_SIZE superblocks and maps them, and LARGE zones of a huge page or
+ *   more, on a huge page boundary with MADV_HUGEPAGE; 2 also tries MAP_HUGETLB for
+ *   SMALL superblocks.
+ * - prof_sample: mean bytes allocated between two heap profile samples (see
+ *   ft_malloc_prof_dump()); 0, the default, turns the profiler off.
+ * - quarantine: in hardened builds, bytes of freed TINY and SMALL allocations kept
+ *   poisoned and out of reuse to catch writes after free (default 0).
+ * - leak_report: file descriptor ft_malloc_leak_report() writes to when the
+ *   program exits; 0, the default, turns the report off.
+ */
+static void config_load(void)
+{
+    t_config *config = &g_config;
+    const char *env = getenv("FT_MALLOC_TCACHE");
+    const char *conf = getenv("FT_MALLOC_CONF");
+    long values[CONF_OPTIONS];
+    cpu_set_t cpus;
+    long cpu_count = 1;
+    long small_min_pages;
+    size_t granule;
+
+    if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0)
+        cpu_count = CPU_COUNT(&cpus);
+    values[CONF_TINY_MAX] = TINY_MAX;
+    values[CONF_SMALL_MAX] = SMALL_MAX;
+    values[CONF_TINY_ZONE_PAGES] = TINY_ZONE_MULTIPLIER;
+    values[CONF_SMALL_ZONE_PAGES] = SMALL_ZONE_MULTIPLIER;
+    values[CONF_RETAIN] = env_long("FT_MALLOC_RETAIN", 1);
+    values[CONF_ARENAS] = env_long("FT_MALLOC_ARENAS", cpu_count);
+    values[CONF_TCACHE] = (env && env[0] == '0') ? 0 : TCACHE_BIN_MAX;
+    values[CONF_SMALL_ALIGN] = env_long("FT_MALLOC_SMALL_ALIGN", ALIGNMENT);
+    values[CONF_THP] = THP_OFF;
+    values[CONF_PROF_SAMPLE] = 0;
+    values[CONF_QUARANTINE] = 0;
+    values[CONF_LEAK_REPORT] = 0;
+    if (conf)
+        conf_parse(conf, values);
+
+    config->page_size = sysconf(_SC_PAGESIZE);
+    config->page_shift = __builtin_ctzl(config->page_size);
+    config->tiny_max = ALIGN(clamp(values[CONF_TINY_MAX], 1, TINY_MAX_LIMIT));
+    config->small_max = ALIGN(clamp(values[CONF_SMALL_MAX], config->tiny_max + 1,
+                                     SMALL_MAX_LIMIT));
+    config->tiny_zone_size = config->page_size
+                             * clamp(values[CONF_TINY_ZONE_PAGES], 1, 1L << 16);
+    granule = values[CONF_SMALL_ALIGN];
+    if (granule < ALIGNMENT || granule > 4096 || (granule & (granule - 1)))
+        granule = ALIGNMENT;
+    config->small_granule = granule;
+    // Eight chunks of the largest SMALL block, past the first block's offset and
+    // the BLOCK_OVERHEAD create_zone() leaves at the end of the zone.
+    small_min_pages = (((ZONE_HEADER_SIZE + BLOCK_SIZE + granule - 1) & ~(granule - 1))
+                       - BLOCK_SIZE + BLOCK_OVERHEAD
+                       + 8 * ((SMALL_PAYLOAD_MAX + BLOCK_OVERHEAD + granule - 1) & ~(granule - 1))
+                       + config->page_size - 1) / config->page_size;
+    config->small_zone_size = config->page_size
+                              * clamp(values[CONF_SMALL_ZONE_PAGES], small_min_pages, 1L << 16);
+    config->thp = clamp(values[CONF_THP], THP_OFF, THP_HUGETLB);
+    if (config->thp != THP_OFF)
+        config->small_zone_size = (config->small_zone_size + HUGE_PAGE_SIZE - 1)
+                                  & ~(HUGE_PAGE_SIZE - 1);
+    config->prof_sample = clamp(values[CONF_PROF_SAMPLE], 0, 1L << 40);
+    config->quarantine = clamp(values[CONF_QUARANTINE], 0, 1L << 40);
+    config->leak_report = clamp(values[CONF_LEAK_REPORT], 0, INT_MAX);
+    config->canary = config_canary();
+    config->retain = clamp(values[CONF_RETAIN], 0, LONG_MAX);
+    config->arenas = clamp(values[CONF_ARENAS], 1, ARENA_MAX);
+    config->tcache = clamp(values[CONF_TCACHE], 0, TCACHE_BIN_LIMIT);
+#ifdef FT_MALLOC_HARDENED
+    config->tcache = 0;
+#endif
+    config_bins(config);
+    __atomic_store_n(&config->loaded, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Loads g_config if it is not loaded yet; cheap once it is.
+ *
+ * Runs as a constructor when the library is loaded; CONFIG_ENSURE() calls it
+ * from the entry points for allocations made by other libraries' constructors
+ * before this one ran.
+ */
+__attribute__((constructor))
+void config_init(void)
+{
+    pthread_once(&g_config_once, config_load);
+}
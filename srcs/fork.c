@@ -0,0 +1,62 @@
+#include "libft_malloc.h"
+#include <pthread.h>
+
+/**
+ * @brief Applies a fork phase to one allocator lock: taken before fork(), released
+ * in the parent, and reinitialized in the child, whose only thread is the one that
+ * took it.
+ *
+ * @param mutex Lock to apply the phase to.
+ * @param phase Fork phase (enum e_fork_phase).
+ */
+void fork_mutex(pthread_mutex_t *mutex, int phase)
+{
+    if (phase == FORK_PREPARE)
+        pthread_mutex_lock(mutex);
+    else if (phase == FORK_PARENT)
+        pthread_mutex_unlock(mutex);
+    else
+        pthread_mutex_init(mutex, NULL);
+}
+
+/**
+ * @brief pthread_atfork() handlers: every allocator lock is held across fork(), so
+ * the child never inherits one taken by a thread that does not exist there.
+ *
+ * The locks are taken in an order no allocation path nests them in (the quarantine,
+ * the arenas in index order, the profiler, then the statistics list) and given back
+ * in reverse.
+ */
+static void fork_prepare(void)
+{
+    harden_fork(FORK_PREPARE);
+    arena_fork(FORK_PREPARE);
+    prof_fork(FORK_PREPARE);
+    stats_fork(FORK_PREPARE);
+}
+
+static void fork_parent(void)
+{
+    stats_fork(FORK_PARENT);
+    prof_fork(FORK_PARENT);
+    arena_fork(FORK_PARENT);
+    harden_fork(FORK_PARENT);
+}
+
+static void fork_child(void)
+{
+    stats_fork(FORK_CHILD);
+    prof_fork(FORK_CHILD);
+    arena_fork(FORK_CHILD);
+    harden_fork(FORK_CHILD);
+}
+
+/**
+ * @brief Registers the fork handlers when the library is loaded, before the program
+ * can create threads: registering them from an allocation could allocate in turn.
+ */
+__attribute__((constructor))
+static void fork_init(void)
+{
+    pthread_atfork(fork_prepare, fork_parent, fork_child);
+}
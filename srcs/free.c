@@ -4,41 +4,126 @@
 #include <stdio.h>
 #include <pthread.h>
 
-extern t_zone *g_zones;
-extern pthread_mutex_t g_mutex;
+/**
+ * @brief Returns a block to its zone. The caller must hold the lock of the zone's arena.
+ *
+ * LARGE zones are unmapped. SMALL blocks are marked free, coalesced with their
+ * immediate free neighbours, and pushed onto their size-class bin; a block that is
+ * already free is left alone. When the merged block spans the whole zone, the zone
+ * is kept as a spare of its arena up to g_config.retain and unmapped beyond it.
+ *
+ * @param zone Zone owning the block.
+ * @param block Header of the block being released.
+ */
+void release_block(t_zone *zone, t_block *block)
+{
+    if (zone->type == LARGE)
+    {
+        release_zone(zone);
+        return;
+    }
+    if (BLOCK_IS_FREE(block))
+    {
+#ifdef FT_MALLOC_HARDENED
+        harden_fail("free()", "double free of", block + 1, zone, NULL);
+#endif
+        return;
+    }
+    block_set(block, BLOCK_PAYLOAD(block), (block->head & BLOCK_FLAGS) | BLOCK_FREE);
+    block = coalesce(zone->arena, block);
+    if (BLOCK_WHOLE_ZONE(block))
+    {
+        if (zone->arena->small_spares >= g_config.retain)
+        {
+            release_zone(zone);
+            return;
+        }
+        zone->arena->small_spares++;
+    }
+    bin_insert(zone->arena, block);
+}
 
 /**
- * @brief Frees the memory block pointed to by ptr.
+ * @brief Returns user memory to its zone, whatever the zone type. Caller holds the
+ * lock of the zone's arena.
  *
- * This function retrieves the block header (located immediately before the user pointer),
- * marks the block as free, coalesces adjacent free blocks to reduce fragmentation, and
- * unmaps the zone if all blocks in it are free (for TINY and SMALL zones) or if it is a
- * LARGE allocation.
+ * @param zone Zone owning the allocation.
+ * @param ptr Pointer to the user memory.
+ */
+void release_ptr(t_zone *zone, void *ptr)
+{
+    if (zone->type == TINY)
+        slab_free(zone, ptr);
+    else
+        release_block(zone, (t_block *)ptr - 1);
+}
+
+/**
+ * @brief Releases an allocation once free() has accepted it.
  *
- * @param ptr Pointer to the memory to be freed. If NULL, no operation is performed.
+ * TINY and SMALL allocations are parked in the calling thread's cache without taking
+ * any lock. Everything else retrieves the owning zone from the page map and is
+ * released under the lock of the zone's arena, whichever thread allocated it;
+ * pointers that belong to no zone are ignored. A thread freeing into another
+ * thread's arena never waits for its lock: if the lock is taken, the allocation
+ * goes onto the arena's remote-free stack instead. Hardened builds always wait, and
+ * have no thread caches, so a freed allocation is free in its zone straight away.
+ *
+ * @param ptr Pointer to the memory to release, not NULL.
  */
-void free(void *ptr)
+void free_release(void *ptr)
 {
-    t_block *block;
     t_zone *zone;
+    t_arena *arena;
 
-    if (!ptr)
+    if (tcache_free(ptr))
         return;
-    block = (t_block *)ptr - 1;
-    pthread_mutex_lock(&g_mutex);
-    zone = get_zone_for_ptr((void *)block);
+    zone = get_zone_for_ptr(ptr);
     if (!zone)
-    {
-        pthread_mutex_unlock(&g_mutex);
         return;
-    }
-    block->free = 1;
-    coalesce(zone);
-    if (zone->type == LARGE)
+    stats_count(STAT_FREES + zone->type);
+    if (__builtin_expect(zone->prof_samples != 0, 0))
+        prof_forget(zone, ptr);
+    // The zone may be unmapped by release_ptr(), so its arena is read beforehand.
+    arena = zone->arena;
+#ifdef FT_MALLOC_HARDENED
+    // Released at once, so a second free() from any thread finds it free.
+    pthread_mutex_lock(&arena->mutex);
+#else
+    if (arena != arena_get())
     {
-        remove_zone(zone);
-        munmap(zone, zone->size);
+        if (pthread_mutex_trylock(&arena->mutex) != 0)
+        {
+            arena_remote_free(arena, ptr, ptr);
+            return;
+        }
     }
+    else
+        pthread_mutex_lock(&arena->mutex);
+#endif
+    arena_drain(arena);
+    release_ptr(zone, ptr);
+    pthread_mutex_unlock(&arena->mutex);
+}
 
-    pthread_mutex_unlock(&g_mutex);
+/**
+ * @brief Frees the memory block pointed to by ptr (see free_release()).
+ *
+ * Hardened builds first validate the pointer and may hold the allocation in
+ * quarantine (see harden_free()).
+ *
+ * @param ptr Pointer to the memory to be freed. If NULL, no operation is performed.
+ */
+void free(void *ptr)
+{
+    if (!ptr)
+        return;
+#ifdef FT_MALLOC_HARDENED
+    ptr = harden_free(ptr, __builtin_return_address(0));
+#elif defined(FT_MALLOC_VALGRIND)
+    if (get_zone_for_ptr(ptr))
+        vg_free(ptr);
+#endif
+    if (ptr)
+        free_release(ptr);
 }
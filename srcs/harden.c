@@ -0,0 +1,257 @@
+#include "libft_malloc.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Byte freed allocations are filled with while they wait in quarantine.
+#define HARDEN_POISON       0xDB
+// Allocations the quarantine holds at once, whatever their size.
+#define QUARANTINE_SLOTS    (1UL << 16)
+
+typedef struct s_quarantine_slot {
+    void            *ptr;
+    size_t          size;
+} t_quarantine_slot;
+
+/**
+ * @brief Freed TINY and SMALL allocations kept out of reuse, oldest first, until
+ * they add up to more than g_config.quarantine bytes.
+ */
+typedef struct s_quarantine {
+    pthread_mutex_t     lock;
+    t_quarantine_slot   *slots;         // ring of QUARANTINE_SLOTS, mapped on first use
+    size_t              first;
+    size_t              count;
+    size_t              bytes;
+} t_quarantine;
+
+static t_quarantine g_quarantine = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+/**
+ * @brief Reports heap misuse or corruption on stderr and aborts.
+ *
+ * The message is formatted on the stack: the heap cannot be trusted any more.
+ *
+ * @param call Entry point that found the problem, such as "free()", or "heap" for
+ *             a corrupted header found while the allocator walks its blocks.
+ * @param problem What is wrong with 'ptr'.
+ * @param zone Zone of 'ptr' if it has one, NULL otherwise.
+ * @param caller Return address into the caller of 'call', NULL if unknown.
+ */
+void harden_fail(const char *call, const char *problem, void *ptr, t_zone *zone, void *caller)
+{
+    t_out out;
+
+    out_init(&out, STDERR_FILENO);
+    out_str(&out, "ft_malloc: ");
+    out_str(&out, call);
+    out_str(&out, ": ");
+    out_str(&out, problem);
+    out_str(&out, " ");
+    out_ptr(&out, ptr);
+    if (zone)
+    {
+        out_str(&out, " in a ");
+        out_str(&out, g_zone_names[zone->type]);
+        out_str(&out, " zone");
+    }
+    if (caller)
+    {
+        out_str(&out, ", called from ");
+        out_symbol(&out, caller);
+    }
+    out_str(&out, "\n");
+    out_flush(&out);
+    abort();
+}
+
+/**
+ * @brief Tells whether 'ptr', tagged as freed, is in quarantine.
+ */
+static int quarantine_holds(void *ptr)
+{
+    t_quarantine *q = &g_quarantine;
+    int found = 0;
+
+    pthread_mutex_lock(&q->lock);
+    for (size_t i = 0; i < q->count && !found; i++)
+        found = q->slots[(q->first + i) % QUARANTINE_SLOTS].ptr == ptr;
+    pthread_mutex_unlock(&q->lock);
+    return found;
+}
+
+/**
+ * @brief Checks that 'ptr' is a live allocation before 'call' releases or resizes it,
+ * and aborts with a diagnostic otherwise.
+ *
+ * The pointer must start a live slab slot or a block whose sealed header is intact,
+ * and the header of the next block must be intact too, which catches most overflows
+ * when the overflowing allocation is freed. An allocation tagged as freed is looked
+ * for in quarantine; hardened builds have no thread caches, so nothing else holds a
+ * freed allocation that its zone still counts as live.
+ *
+ * @return Zone of the allocation.
+ */
+t_zone *harden_check(void *ptr, void *caller, const char *call)
+{
+    t_zone *zone = get_zone_for_ptr(ptr);
+    t_slab *slab;
+    t_block *block = (t_block *)ptr - 1;
+    size_t offset;
+
+    if (!zone)
+        harden_fail(call, "invalid pointer", ptr, NULL, caller);
+    if (zone->type == TINY)
+    {
+        slab = &zone->slab;
+        offset = (char *)ptr - slab->objects;
+        if ((char *)ptr < slab->objects || offset % slab->obj_size
+            || offset / slab->obj_size >= slab->bump)
+            harden_fail(call, "invalid pointer", ptr, zone, caller);
+        if (!slab_is_live(zone, offset / slab->obj_size))
+            harden_fail(call, "double free of", ptr, zone, caller);
+    }
+    else
+    {
+        if ((uintptr_t)ptr % ALIGNMENT || block < zone->blocks
+            || (zone->type == LARGE && block != zone->blocks))
+            harden_fail(call, "invalid pointer", ptr, zone, caller);
+        if (!BLOCK_SEALED(block))
+            harden_fail(call, "invalid pointer or corrupted block header at", ptr, zone, caller);
+        if (BLOCK_IS_FREE(block))
+            harden_fail(call, "double free of", ptr, zone, caller);
+        if (BLOCK_NEXT(block) && !BLOCK_SEALED(BLOCK_NEXT(block)))
+            harden_fail(call, "heap overflow past", ptr, zone, caller);
+    }
+    if (zone->type != LARGE && vg_freed_tagged(ptr) && quarantine_holds(ptr))
+        harden_fail(call, "double free of", ptr, zone, caller);
+    return zone;
+}
+
+/**
+ * @brief Takes the oldest allocation out of quarantine if 'size' more bytes would
+ * not fit, and checks that nothing wrote to it while it was there.
+ *
+ * @return The allocation, to be released, or NULL if there is room.
+ */
+static void *quarantine_evict(size_t size)
+{
+    t_quarantine *q = &g_quarantine;
+    t_quarantine_slot slot = {NULL, 0};
+    const unsigned char *bytes;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->count && (q->bytes + size > g_config.quarantine || q->count == QUARANTINE_SLOTS))
+    {
+        slot = q->slots[q->first];
+        q->first = (q->first + 1) % QUARANTINE_SLOTS;
+        q->count--;
+        q->bytes -= slot.size;
+    }
+    pthread_mutex_unlock(&q->lock);
+    bytes = slot.ptr;
+    vg_defined(bytes, slot.size);
+    for (size_t i = 0; i < slot.size; i++)
+    {
+        if (bytes[i] != HARDEN_POISON && (i < sizeof(uintptr_t) || i >= 2 * sizeof(uintptr_t)))
+            harden_fail("free()", "write after free to", slot.ptr, get_zone_for_ptr(slot.ptr), NULL);
+    }
+    if (slot.ptr)
+        FREED_TAG(slot.ptr) = 0;
+    return slot.ptr;
+}
+
+/**
+ * @brief Puts a freed allocation in quarantine, poisoned and tagged as freed.
+ *
+ * @return 0 if it was queued, -1 if it does not fit (or the ring cannot be mapped).
+ */
+static int quarantine_push(void *ptr, size_t size)
+{
+    t_quarantine *q = &g_quarantine;
+    t_quarantine_slot *slot;
+    void *slots;
+    int ret = -1;
+
+    vg_defined(ptr, size);
+    memset(ptr, HARDEN_POISON, size);
+    FREED_TAG(ptr) = g_config.canary;
+    pthread_mutex_lock(&q->lock);
+    if (!q->slots)
+    {
+        slots = mmap(NULL, QUARANTINE_SLOTS * sizeof(t_quarantine_slot), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        q->slots = slots == MAP_FAILED ? NULL : slots;
+    }
+    if (q->slots && q->count < QUARANTINE_SLOTS && q->bytes + size <= g_config.quarantine)
+    {
+        slot = &q->slots[(q->first + q->count) % QUARANTINE_SLOTS];
+        slot->ptr = ptr;
+        slot->size = size;
+        q->count++;
+        q->bytes += size;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&q->lock);
+    if (ret != 0)
+        FREED_TAG(ptr) = 0;
+    else
+        vg_noaccess((char *)ptr + 2 * sizeof(uintptr_t), size - 2 * sizeof(uintptr_t));
+    return ret;
+}
+
+/**
+ * @brief Hardened front of free(): validates 'ptr' (see harden_check()) and, with
+ * a quarantine configured, delays the reuse of TINY and SMALL allocations.
+ *
+ * Allocations leaving quarantine to make room are released past this check, so
+ * they reach the thread cache and the zones like any other.
+ *
+ * @param ptr Pointer passed to free(), not NULL.
+ * @param caller Return address of free().
+ * @return 'ptr' if free() must release it now, NULL if it was quarantined.
+ */
+void *harden_free(void *ptr, void *caller)
+{
+    t_zone *zone;
+    size_t size;
+    void *victim;
+
+    zone = harden_check(ptr, caller, "free()");
+    vg_free(ptr);
+    if (!g_config.quarantine || zone->type == LARGE)
+        return ptr;
+    size = alloc_size(zone, ptr);
+    while ((victim = quarantine_evict(size)) != NULL)
+        free_release(victim);
+    return quarantine_push(ptr, size) == 0 ? NULL : ptr;
+}
+
+/**
+ * @brief Releases everything in quarantine, checking it for writes after free.
+ */
+void harden_release(void)
+{
+    void *victim;
+
+    while ((victim = quarantine_evict(g_config.quarantine + 1)) != NULL)
+        free_release(victim);
+}
+
+/**
+ * @brief Fork handler of the quarantine lock (see fork_mutex()).
+ */
+void harden_fork(int phase)
+{
+    fork_mutex(&g_quarantine.lock, phase);
+}
+
+/**
+ * @brief Turns the guard page ending a LARGE zone on or off; it must be off while
+ * the zone is remapped.
+ */
+void harden_guard(t_zone *zone, int on)
+{
+    mprotect((char *)zone + zone->size - LARGE_GUARD_SIZE, LARGE_GUARD_SIZE,
+             on ? PROT_NONE : PROT_READ | PROT_WRITE);
+}
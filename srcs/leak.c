@@ -0,0 +1,128 @@
+#include "libft_malloc.h"
+#include <errno.h>
+#include <string.h>
+
+// Size classes of the report: one per ALIGNMENT bytes up to 64, then four per
+// doubling, like the SMALL bins, up to the largest size_t.
+#define LEAK_CLASSES    (4 + 4 * (64 - 6))
+// Call sites listed when the heap profiler is on.
+#define LEAK_SITES      10
+
+typedef struct s_leak_class {
+    size_t          count;
+    size_t          bytes;
+} t_leak_class;
+
+static size_t leak_class(size_t size)
+{
+    size_t log;
+
+    if (size <= 64)
+        return size ? (size - 1) / ALIGNMENT : 0;
+    log = 63 - __builtin_clzl(size - 1);
+    return 4 + ((log - 6) << 2) + (((size - 1) >> (log - 2)) & 3);
+}
+
+// Largest usable size of a class.
+static size_t leak_class_max(size_t class)
+{
+    size_t log;
+
+    if (class < 4)
+        return (class + 1) * ALIGNMENT;
+    log = 6 + ((class - 4) >> 2);
+    return (1UL << log) + (((class - 4) & 3) + 1) * (1UL << (log - 2));
+}
+
+static void report_classes(t_out *out, t_leak_class classes[ZONE_TYPES][LEAK_CLASSES])
+{
+    for (int type = 0; type < ZONE_TYPES; type++)
+    {
+        for (size_t class = 0; class < LEAK_CLASSES; class++)
+        {
+            if (!classes[type][class].count)
+                continue;
+            out_str(out, "  ");
+            out_str(out, g_zone_names[type]);
+            out_str(out, " up to ");
+            out_dec(out, leak_class_max(class));
+            out_str(out, " bytes: ");
+            out_dec(out, classes[type][class].count);
+            out_str(out, " allocations, ");
+            out_dec(out, classes[type][class].bytes);
+            out_str(out, " bytes\n");
+        }
+    }
+}
+
+/**
+ * @brief Writes the live allocations to 'fd', grouped by zone type and size class,
+ * followed by the call sites holding the most live bytes when the heap profiler is
+ * on (see prof_report_sites()).
+ *
+ * The allocations are listed from a snapshot (see snapshot_take()), which leaves
+ * out those parked in thread caches, and counted on the stack: nothing is allocated,
+ * stdio is not involved and errno is preserved. Sizes are usable sizes. Hardened
+ * builds empty the quarantine first, which checks it for writes after free.
+ *
+ * @param fd File descriptor to write to.
+ * @return 0 on success, -1 if the snapshot buffer could not be mapped.
+ */
+int ft_malloc_leak_report(int fd)
+{
+    int saved_errno = errno;
+    t_leak_class classes[ZONE_TYPES][LEAK_CLASSES];
+    const t_snapshot_entry *entry;
+    t_leak_class *class;
+    size_t count = 0;
+    size_t bytes = 0;
+    t_snapshot snap;
+    t_out out;
+
+    CONFIG_ENSURE();
+#ifdef FT_MALLOC_HARDENED
+    harden_release();
+#endif
+    if (snapshot_take(&snap) != 0)
+    {
+        errno = saved_errno;
+        return -1;
+    }
+    memset(classes, 0, sizeof(classes));
+    for (size_t i = 0; i < snap.count; i++)
+    {
+        entry = &snap.entries[i];
+        if (entry->kind != SNAPSHOT_ALLOC)
+            continue;
+        class = &classes[entry->type][leak_class(entry->size)];
+        class->count++;
+        class->bytes += entry->size;
+        count++;
+        bytes += entry->size;
+    }
+    out_init(&out, fd);
+    out_str(&out, "ft_malloc: ");
+    out_dec(&out, count);
+    out_str(&out, " live allocations, ");
+    out_dec(&out, bytes);
+    out_str(&out, " bytes\n");
+    snapshot_report_busy(&out, &snap);
+    report_classes(&out, classes);
+    prof_report_sites(&out, LEAK_SITES);
+    out_flush(&out);
+    snapshot_release(&snap);
+    errno = saved_errno;
+    return 0;
+}
+
+/**
+ * @brief Writes the leak report to the FT_MALLOC_CONF=leak_report descriptor when
+ * the program exits. Library destructors run after the exit handlers and destructors
+ * of the program, so what those free is not reported.
+ */
+__attribute__((destructor))
+static void leak_report_at_exit(void)
+{
+    if (g_config.leak_report)
+        ft_malloc_leak_report(g_config.leak_report);
+}
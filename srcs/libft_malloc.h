@@ -2,20 +2,71 @@
 # define LIBFT_MALLOC_H
 
 
+// Default class thresholds; FT_MALLOC_CONF (tiny_max, small_max) may move them up
+// to the limits, which size the per-class tables.
 #define TINY_MAX        64
 #define SMALL_MAX       1024
+#define TINY_MAX_LIMIT  256
+#define SMALL_MAX_LIMIT 4096
 
+// Default zone sizes in pages (tiny_zone_pages, small_zone_pages); g_config holds
+// them in bytes.
 #define TINY_ZONE_MULTIPLIER   16
 #define SMALL_ZONE_MULTIPLIER  128
 
-#define TINY_ZONE_SIZE   (sysconf(_SC_PAGESIZE) * TINY_ZONE_MULTIPLIER)
-#define SMALL_ZONE_SIZE  (sysconf(_SC_PAGESIZE) * SMALL_ZONE_MULTIPLIER)
+// Huge page modes (thp): SMALL zones become HUGE_PAGE_SIZE superblocks and LARGE
+// zones of at least HUGE_PAGE_SIZE are mapped on a HUGE_PAGE_SIZE boundary, advised
+// with MADV_HUGEPAGE; THP_HUGETLB backs SMALL superblocks with MAP_HUGETLB pages
+// while the kernel has some reserved.
+#define THP_OFF         0
+#define THP_MADVISE     1
+#define THP_HUGETLB     2
+#define HUGE_PAGE_SIZE  (2UL << 20)
+
+// Every allocation is aligned to ALIGNMENT bytes, max_align_t.
+#define ALIGNMENT       16
+#define ALIGN(size)     (((size) + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1))
+
+// Metadata bytes per SMALL/LARGE allocation: the block header minus the word it
+// borrows from the end of the previous payload (see t_block).
+#define BLOCK_OVERHEAD  sizeof(size_t)
+// Smallest block payload holding 'size' bytes.
+#define BLOCK_ROUND(size)   (ALIGN((size) + BLOCK_OVERHEAD) - BLOCK_OVERHEAD)
+// Largest SMALL payload: what a g_config.small_max request gets.
+#define SMALL_PAYLOAD_MAX   (g_config.small_max + BLOCK_OVERHEAD)
+
+// Size actually served for a request: a multiple of ALIGNMENT for TINY objects,
+// a block payload for SMALL and LARGE ones (LARGE ones stay above SMALL_PAYLOAD_MAX).
+#define REQUEST_SIZE(size)  ((size) <= g_config.tiny_max ? ALIGN(size) \
+                            : (size) <= g_config.small_max ? BLOCK_ROUND(size) \
+                            : ALIGN(size) + BLOCK_OVERHEAD)
+
+// One slab class per ALIGNMENT bytes up to TINY_MAX_LIMIT.
+#define TINY_CLASSES    (TINY_MAX_LIMIT / ALIGNMENT)
+// One class per ALIGNMENT bytes up to 64, then four geometric classes per doubling
+// up to SMALL_MAX_LIMIT, plus one bin for larger free blocks.
+#define SMALL_BINS      29
+// Blocks too small for a request looked at in its own bin before a larger class is
+// taken instead.
+#define BIN_SCAN        8
+// Entries of the SMALL bin lookup table, one per ALIGNMENT bytes up to SMALL_MAX_LIMIT.
+#define SMALL_BIN_SLOTS (SMALL_MAX_LIMIT / ALIGNMENT)
+
+// Upper bound on FT_MALLOC_ARENAS; the default is the number of usable CPUs. Sets
+// of arenas are uint64_t bit masks, so it cannot go past 64.
+#define ARENA_MAX       64
+
+#define TCACHE_BINS        (ALIGN(SMALL_MAX_LIMIT + BLOCK_OVERHEAD) / ALIGNMENT)
+#define TCACHE_BIN(size)   (ALIGN(size) / ALIGNMENT - 1)
+// Default entries per thread-cache bin (tcache); a refill brings half of it.
+#define TCACHE_BIN_MAX     16
+#define TCACHE_BIN_LIMIT   1024
 
 # include <stdlib.h>
 # include <stddef.h>
+# include <stdint.h>
 # include <sys/types.h>
 # include <pthread.h>
-# include <valgrind/memcheck.h>
 
 
 
@@ -29,43 +80,325 @@
 typedef enum e_zone_type {
     TINY,
     SMALL,
-    LARGE
+    LARGE,
+    ZONE_TYPES
 } t_zone_type;
 
+// Name of each zone type in reports, indexed by t_zone_type.
+extern const char *const g_zone_names[ZONE_TYPES];
+
+// Zone type serving a request of 'aligned_size' bytes, from REQUEST_SIZE().
+#define SIZE_TYPE(aligned_size) ((aligned_size) <= g_config.tiny_max ? TINY \
+                                : (aligned_size) <= SMALL_PAYLOAD_MAX ? SMALL : LARGE)
+
 /**
- * @brief Header structure for a memory block.
+ * @brief Header structure for a SMALL or LARGE memory block.
  *
- * Each allocated block has a header storing the size, free flag,
- * and pointers to the next and previous blocks.
+ * 'head' holds the chunk size (from this header to the next one, a multiple of
+ * ALIGNMENT) with the BLOCK_* flags in its low bits; while the block is allocated
+ * only its owner writes it. Physical neighbours are implicit: the next block starts
+ * one chunk further, and the previous one 'prev_size' bytes before the header.
+ * That boundary tag is only written while the previous block is free (flagged by
+ * BLOCK_PREV_FREE); otherwise the word belongs to the previous payload, so an
+ * allocation only pays for 'head'.
  */
 typedef struct s_block {
-    size_t          size;
-    int             free;
-    struct s_block  *next;
-    struct s_block  *prev;
+    size_t          prev_size;
+    size_t          head;
 } t_block;
 
 #define BLOCK_SIZE (sizeof(t_block))
 
+#define BLOCK_FREE      1UL     // block is free (and in a bin)
+#define BLOCK_FIRST     2UL     // no predecessor in the zone
+#define BLOCK_LAST      4UL     // no successor in the zone
+#define BLOCK_PREV_FREE 8UL     // predecessor is free, 'prev_size' is valid
+#define BLOCK_FLAGS     (ALIGNMENT - 1UL)
+
+// Hardened builds (make HARDENED=1) seal every block head with a keyed checksum in
+// its top bits, checked before a block is trusted (see harden_check()).
+#ifdef FT_MALLOC_HARDENED
+# define BLOCK_HEAD_MASK    ((1UL << 48) - 1)
+# define BLOCK_SEAL(b, h)   ((h) | block_seal((b), (h)))
+# define BLOCK_SEALED(b)    block_sealed(b)
+#else
+# define BLOCK_HEAD_MASK    (~0UL)
+# define BLOCK_SEAL(b, h)   (h)
+# define BLOCK_SEALED(b)    1
+#endif
+
+#define BLOCK_CHUNK(b)      ((b)->head & BLOCK_HEAD_MASK & ~BLOCK_FLAGS)
+#define BLOCK_PAYLOAD(b)    (BLOCK_CHUNK(b) - BLOCK_OVERHEAD)
+#define BLOCK_IS_FREE(b)    ((b)->head & BLOCK_FREE)
+#define BLOCK_WHOLE_ZONE(b) (((b)->head & (BLOCK_FIRST | BLOCK_LAST)) == (BLOCK_FIRST | BLOCK_LAST))
+#define BLOCK_NEXT(b)       (((b)->head & BLOCK_LAST) ? NULL \
+                            : (t_block *)((char *)(b) + BLOCK_CHUNK(b)))
+#define BLOCK_PREV(b)       (((b)->head & BLOCK_PREV_FREE) \
+                            ? (t_block *)((char *)(b) - (b)->prev_size) : NULL)
+
+/**
+ * @brief Size-class list links stored in the payload of a free SMALL block.
+ */
+typedef struct s_free_links {
+    t_block         *next_free;
+    t_block         *prev_free;
+} t_free_links;
+
+#define FREE_LINKS(block) ((t_free_links *)((block) + 1))
+
+/**
+ * @brief Slab bookkeeping for a TINY zone serving a single size class.
+ *
+ * Objects carry no header: a bitmap (one bit per slot, set when live) follows the
+ * zone header, and freed slots are chained through their first word. Slots past
+ * 'bump' have never been handed out.
+ */
+typedef struct s_slab {
+    size_t          obj_size;
+    unsigned int    capacity;
+    unsigned int    live;
+    unsigned int    bump;
+    void            *free_list;
+    unsigned long   *bitmap;
+    char            *objects;
+    struct s_zone   *next_partial;
+    struct s_zone   *prev_partial;
+} t_slab;
+
 // Zone structure: represents a memory zone allocated with mmap.
 /**
  * @brief Structure representing a memory zone allocated via mmap.
  *
- * A zone contains a header and one or more blocks.
+ * A SMALL or LARGE zone contains a header and one or more blocks; a TINY zone
+ * is a slab of headerless objects of one size class. Every zone belongs to the
+ * arena that mapped it, whose lock protects all of its blocks.
  */
 typedef struct s_zone {
     t_zone_type     type;
+    unsigned int    prof_samples;       // sampled allocations live in the zone
     size_t          size;
+    struct s_arena  *arena;
     struct s_zone   *next;
+    struct s_zone   *prev;
     t_block         *blocks;
+    t_slab          slab;
 } t_zone;
 
+// Blocks of a LARGE zone start right after the header, rounded to ALIGNMENT.
+#define ZONE_HEADER_SIZE    ALIGN(sizeof(t_zone))
+
+// Hardened builds end every LARGE zone with an inaccessible guard page; the zone
+// size of a LARGE block spanning 'total' bytes from the zone start includes it.
+#ifdef FT_MALLOC_HARDENED
+# define LARGE_GUARD_SIZE       g_config.page_size
+# define LARGE_ZONE_SIZE(total) ((((total) + g_config.page_size - 1) \
+                                & ~(g_config.page_size - 1)) + LARGE_GUARD_SIZE)
+#else
+# define LARGE_GUARD_SIZE       0UL
+# define LARGE_ZONE_SIZE(total) (total)
+#endif
+
+// Largest request served: what a LARGE zone adds on top of it (zone and block headers,
+// rounding to ALIGNMENT and to pages, the guard page, huge page slack) must not wrap.
+#define REQUEST_MAX     (SIZE_MAX - (ZONE_HEADER_SIZE + BLOCK_SIZE + 4 * ALIGNMENT \
+                        + g_config.page_size + LARGE_GUARD_SIZE + HUGE_PAGE_SIZE))
+
+/**
+ * @brief Allocator geometry and tunables, computed once by config_init() (a library
+ * constructor) and only read afterwards.
+ */
+typedef struct s_config {
+    int             loaded;
+    size_t          page_size;
+    unsigned int    page_shift;         // log2(page_size), the page map granularity
+    size_t          tiny_max;           // largest TINY request, a multiple of ALIGNMENT
+    size_t          small_max;          // largest SMALL request, a multiple of ALIGNMENT
+    size_t          tiny_zone_size;
+    size_t          small_zone_size;
+    size_t          small_granule;      // alignment of SMALL payloads
+    size_t          retain;             // spare zones of each type kept per arena
+    size_t          arenas;
+    unsigned int    tcache;             // entries per thread-cache bin, 0 if disabled
+    int             thp;                // THP_OFF, THP_MADVISE or THP_HUGETLB
+    size_t          prof_sample;        // mean bytes between heap profile samples, 0 if off
+    size_t          quarantine;         // bytes of freed allocations held back (hardened)
+    int             leak_report;        // fd the leak report is written to at exit, 0 if off
+    uint64_t        canary;             // secret of the freed tags (and hardened block seals)
+    unsigned char   small_bins[SMALL_BIN_SLOTS];
+} t_config;
+
+extern t_config g_config;
+
+// Loads g_config on the first allocation if no constructor did it yet.
+#define CONFIG_ENSURE() do { \
+        if (__builtin_expect(!__atomic_load_n(&g_config.loaded, __ATOMIC_ACQUIRE), 0)) \
+            config_init(); \
+    } while (0)
+
+/**
+ * @brief An independent heap: its own lock, zone list, SMALL bins and TINY slabs.
+ *
+ * Threads are bound to an arena round-robin on their first allocation and allocate
+ * from it; a block is always released to the arena of the zone holding it. Threads
+ * that find the arena of a block they free locked push it onto 'remote_frees', a
+ * lock-free stack the next allocation under the lock drains.
+ */
+typedef struct s_arena {
+    pthread_mutex_t mutex;
+    t_zone          *zones;
+    t_block         *bins[SMALL_BINS];
+    unsigned long   bin_map;
+    size_t          small_spares;
+    t_zone          *slabs[TINY_CLASSES];
+    t_zone          *spare_slabs;
+    size_t          spare_slab_count;
+    void            *remote_frees;
+    // Footprint counters, written under the lock with ARENA_STAT_ADD() and read
+    // without it by ft_malloc_stats().
+    size_t          zone_count[ZONE_TYPES];
+    size_t          mapped[ZONE_TYPES];     // bytes of the zones on the list
+    size_t          small_free;             // chunk bytes of the binned SMALL blocks
+    size_t          tiny_live;              // bytes of live TINY objects
+} __attribute__((aligned(64))) t_arena;
+
+#define ARENA_STAT_ADD(counter, delta) \
+    __atomic_store_n(&(counter), (counter) + (delta), __ATOMIC_RELAXED)
+
+/**
+ * @brief Footprint and activity of one zone type, as returned by ft_malloc_stats().
+ *
+ * 'in_use' is what allocations hold: live TINY objects, the mapped SMALL bytes
+ * minus the free blocks (so headers count as used, as in mallinfo2()), and whole
+ * LARGE zones. 'free' is the rest of 'mapped'. Allocations parked in thread caches
+ * count as in use.
+ */
+typedef struct s_malloc_type_stats {
+    size_t          zones;
+    size_t          mapped;
+    size_t          in_use;
+    size_t          free;
+    size_t          allocs;             // malloc/calloc/memalign family calls served
+    size_t          frees;              // free() calls
+} t_malloc_type_stats;
+
+typedef struct s_malloc_stats {
+    size_t              mapped;
+    size_t              in_use;
+    size_t              free;
+    size_t              reallocs;
+    t_malloc_type_stats types[ZONE_TYPES];
+} t_malloc_stats;
+
 //=============================================================================
-// Global Zone Lists
+// Configuration
 //=============================================================================
 
-extern pthread_mutex_t g_mutex;
-extern t_zone *g_zones;
+void config_init(void);
+
+//=============================================================================
+// Hardening
+//=============================================================================
+
+#ifdef FT_MALLOC_HARDENED
+void harden_fail(const char *call, const char *problem, void *ptr, t_zone *zone,
+                 void *caller) __attribute__((noreturn));
+t_zone *harden_check(void *ptr, void *caller, const char *call);
+void *harden_free(void *ptr, void *caller);
+void harden_guard(t_zone *zone, int on);
+void harden_release(void);
+void harden_fork(int phase);
+
+/**
+ * @brief Checksum of a block head (without its seal) at a given address, keyed with
+ * g_config.canary, in the bits BLOCK_HEAD_MASK leaves free.
+ */
+static inline size_t block_seal(const t_block *block, size_t head)
+{
+    uint64_t mix = ((uintptr_t)block ^ head ^ g_config.canary) * 0x9E3779B97F4A7C15ULL;
+
+    return (mix ^ (mix >> 29)) & ~BLOCK_HEAD_MASK;
+}
+
+/**
+ * @brief Tells whether a block head carries its seal. The head is loaded once: the
+ * neighbours of an allocation are checked without their arena lock.
+ */
+static inline int block_sealed(const t_block *block)
+{
+    size_t head = __atomic_load_n(&block->head, __ATOMIC_RELAXED);
+
+    return (head & ~BLOCK_HEAD_MASK) == block_seal(block, head & BLOCK_HEAD_MASK);
+}
+#else
+# define harden_guard(zone, on) ((void)0)
+# define harden_fork(phase) ((void)0)
+#endif
+
+//=============================================================================
+// Valgrind
+//=============================================================================
+
+/*
+ * make VALGRIND=1 (FT_MALLOC_VALGRIND) describes the heap to Valgrind with client
+ * requests: zones are superblocks of a meta mempool per arena, allocations are
+ * malloc-like blocks inside them, and a zone is NOACCESS past its header until
+ * the allocator places metadata in it, which it marks defined first. Other builds
+ * compile every call below out.
+ */
+#ifdef FT_MALLOC_VALGRIND
+void vg_init(void);
+void vg_defined(const void *addr, size_t size);
+void vg_noaccess(const void *addr, size_t size);
+int vg_freed_tagged(void *ptr);
+void vg_alloc(void *ptr, int zeroed);
+void vg_free(void *ptr);
+void vg_resize(void *old_ptr, void *ptr, size_t old_size);
+void vg_zone_map(t_zone *zone);
+void vg_zone_move(void *old_zone, t_zone *zone, size_t old_size);
+void vg_zone_unmap(t_zone *zone);
+#else
+# define vg_init() ((void)0)
+# define vg_defined(addr, size) ((void)0)
+# define vg_noaccess(addr, size) ((void)0)
+# define vg_freed_tagged(ptr) FREED_TAGGED(ptr)
+# define vg_alloc(ptr, zeroed) ((void)0)
+# define vg_free(ptr) ((void)0)
+# define vg_resize(old_ptr, ptr, old_size) ((void)0)
+# define vg_zone_map(zone) ((void)0)
+# define vg_zone_move(old_zone, zone, old_size) ((void)0)
+# define vg_zone_unmap(zone) ((void)0)
+#endif
+
+//=============================================================================
+// Arenas
+//=============================================================================
+
+extern t_arena g_arenas[ARENA_MAX];
+
+size_t arena_count(void);
+t_arena *arena_get(void);
+t_arena *arena_lock(void);
+int arena_try_lock(t_arena *arena);
+uint64_t arena_lock_all(int drain);
+void arena_unlock_all(uint64_t locked);
+void arena_remote_free(t_arena *arena, void *first, void *last);
+void arena_drain(t_arena *arena);
+void arena_fork(int phase);
+
+//=============================================================================
+// Fork
+//=============================================================================
+
+/**
+ * @brief Phases of fork() the allocator locks go through (see fork_mutex()).
+ */
+enum e_fork_phase {
+    FORK_PREPARE,                       // in the parent, before fork()
+    FORK_PARENT,                        // in the parent, after fork()
+    FORK_CHILD                          // in the child, after fork()
+};
+
+void fork_mutex(pthread_mutex_t *mutex, int phase);
 
 /*
  * Allocates "size" bytes of memory and returns a pointer to the allocated memory.
@@ -85,6 +418,25 @@ void	free(void *ptr);
  */
 void	*realloc(void *ptr, size_t size);
 
+/*
+ * Allocates zeroed memory for an array of "nmemb" elements of "size" bytes.
+ */
+void	*calloc(size_t nmemb, size_t size);
+
+/*
+ * Aligned allocations, all released with free().
+ */
+int		posix_memalign(void **memptr, size_t alignment, size_t size);
+void	*aligned_alloc(size_t alignment, size_t size);
+void	*memalign(size_t alignment, size_t size);
+void	*valloc(size_t size);
+void	*pvalloc(size_t size);
+
+/*
+ * Returns the number of usable bytes in the allocation pointed to by "ptr".
+ */
+size_t	malloc_usable_size(void *ptr);
+
 /*
  * Displays the current state of the allocated memory zones.
  */
@@ -92,10 +444,267 @@ void	show_alloc_mem(void);
 
 void    show_alloc_mem_hex(void);
 
+/*
+ * Same reports written to "fd" without allocating; safe to call from a signal
+ * handler (arenas whose lock stays taken are reported as busy and skipped).
+ */
+void    show_alloc_mem_fd(int fd);
+void    show_alloc_mem_hex_fd(int fd);
+
+/*
+ * Writes a heap map to "fd" from a snapshot taken under a short lock. Formats:
+ * - FT_MALLOC_DUMP_TEXT: the show_alloc_mem() report.
+ * - FT_MALLOC_DUMP_JSON: {"zones": [{"type", "addr", "size", "allocations":
+ *   [{"addr", "size"}, ...]}, ...], "skipped_arenas": [...], "allocations",
+ *   "bytes"}, addresses as "0x..." strings.
+ * - FT_MALLOC_DUMP_BINARY: a t_dump_header followed by header.count t_dump_record,
+ *   in host byte order; each zone record precedes the records of its allocations.
+ * Returns 0, or -1 if the snapshot buffer could not be mapped.
+ */
+#define FT_MALLOC_DUMP_TEXT     0
+#define FT_MALLOC_DUMP_JSON     1
+#define FT_MALLOC_DUMP_BINARY   2
+
+#define DUMP_MAGIC      "FTHEAP\0\0"
+#define DUMP_VERSION    1
+
+typedef struct s_dump_header {
+    char            magic[8];           // DUMP_MAGIC
+    uint32_t        version;            // DUMP_VERSION
+    uint32_t        record_size;        // sizeof(t_dump_record)
+    uint64_t        count;              // records that follow
+    uint64_t        skipped_arenas;     // bit i: arena i was busy and is missing
+} t_dump_header;
+
+typedef struct s_dump_record {
+    uint64_t        addr;
+    uint64_t        size;               // zone size, or usable size of an allocation
+    uint32_t        kind;               // 0: zone, 1: allocation
+    uint32_t        type;               // 0: TINY, 1: SMALL, 2: LARGE
+} t_dump_record;
+
+int     ft_malloc_dump(int fd, int format);
+
+/*
+ * Returns the mapped, used and free bytes and the allocation counts of every zone
+ * type, without locking any arena. mallinfo2() reports the same figures in the
+ * glibc layout.
+ */
+t_malloc_stats ft_malloc_stats(void);
+
+/*
+ * Writes the sampled heap profile (FT_MALLOC_CONF=prof_sample:<bytes>) to "fd":
+ * live or cumulative bytes by call site, estimated from one sample every
+ * prof_sample bytes allocated on average. Formats:
+ * - FT_MALLOC_PROF_FOLDED_LIVE, FT_MALLOC_PROF_FOLDED_ALLOC: folded stacks,
+ *   "outer;...;inner bytes" per line, for flame graph tools.
+ * - FT_MALLOC_PROF_PPROF: the gperftools text heap profile read by pprof.
+ * Returns 0, or -1 if profiling is off.
+ */
+#define FT_MALLOC_PROF_FOLDED_LIVE  0
+#define FT_MALLOC_PROF_FOLDED_ALLOC 1
+#define FT_MALLOC_PROF_PPROF        2
+
+int     ft_malloc_prof_dump(int fd, int format);
+
+/*
+ * Writes a summary of the live allocations to "fd": counts and bytes by zone type
+ * and size class, then the call sites holding the most memory when the heap
+ * profiler is on. Allocations parked in thread caches or in quarantine are not
+ * counted; nothing is allocated. FT_MALLOC_CONF=leak_report:<fd> writes
+ * it when the program exits. Returns 0, or -1 if the heap could not be walked.
+ */
+int     ft_malloc_leak_report(int fd);
+
 
 t_zone *get_zone_for_ptr(void *ptr);
-void coalesce(t_zone *zone);
+t_zone *map_zone(t_arena *arena, t_zone_type type, size_t zone_size);
+void add_zone(t_zone *zone);
 void remove_zone(t_zone *zone);
+void release_zone(t_zone *zone);
+t_block *coalesce(t_arena *arena, t_block *block);
+t_block *alloc_block(t_arena *arena, size_t aligned_size);
+void *alloc_ptr(t_arena *arena, size_t aligned_size);
+void *alloc_aligned(t_arena *arena, size_t alignment, size_t aligned_size);
+size_t alloc_size(t_zone *zone, void *ptr);
+size_t small_size(size_t size);
+void block_set(t_block *block, size_t payload, size_t flags);
+void release_block(t_zone *zone, t_block *block);
+void release_ptr(t_zone *zone, void *ptr);
+void free_release(void *ptr);
+void bin_insert(t_arena *arena, t_block *block);
+void bin_remove(t_arena *arena, t_block *block);
+
+//=============================================================================
+// TINY Slabs
+//=============================================================================
+
+void *slab_alloc(t_arena *arena, size_t aligned_size);
+void slab_free(t_zone *zone, void *ptr);
+int slab_is_live(t_zone *zone, size_t index);
+
+//=============================================================================
+// Output
+//=============================================================================
+
+#define OUT_BUFFER_SIZE 4096
+
+/**
+ * @brief Formatting buffer on the caller's stack, written to 'fd' with write(2) in
+ * OUT_BUFFER_SIZE chunks: reports never allocate nor go through stdio.
+ */
+typedef struct s_out {
+    int             fd;
+    size_t          len;
+    char            buf[OUT_BUFFER_SIZE];
+} t_out;
+
+void out_init(t_out *out, int fd);
+void out_flush(t_out *out);
+void out_mem(t_out *out, const char *data, size_t len);
+void out_str(t_out *out, const char *str);
+void out_dec(t_out *out, size_t value);
+void out_hex(t_out *out, size_t value, size_t width, int upper);
+void out_ptr(t_out *out, const void *ptr);
+void out_symbol(t_out *out, void *frame);
+
+//=============================================================================
+// Heap Snapshots
+//=============================================================================
+
+enum e_snapshot_kind {
+    SNAPSHOT_ZONE,
+    SNAPSHOT_ALLOC
+};
+
+/**
+ * @brief A zone or a live allocation, as recorded by snapshot_take().
+ */
+typedef struct s_snapshot_entry {
+    uintptr_t       addr;
+    size_t          size;               // zone size, or usable size of the allocation
+    t_zone          *zone;              // owning zone, checked by snapshot_read()
+    unsigned char   kind;               // enum e_snapshot_kind
+    unsigned char   type;               // t_zone_type
+} t_snapshot_entry;
+
+typedef struct s_snapshot {
+    t_snapshot_entry    *entries;       // mmap'd, sorted by type then address
+    size_t              count;
+    size_t              capacity;
+    uint64_t            arenas;         // arenas included, one bit per index
+} t_snapshot;
+
+int snapshot_take(t_snapshot *snap);
+void snapshot_release(t_snapshot *snap);
+int snapshot_read(const t_snapshot_entry *entry, size_t offset, void *buf, size_t len);
+void snapshot_report_busy(t_out *out, const t_snapshot *snap);
+
+//=============================================================================
+// Page Map
+//=============================================================================
+
+int pagemap_register(t_zone *zone);
+void pagemap_unregister(t_zone *zone);
+int pagemap_register_range(const void *start, size_t size, t_zone *zone);
+void pagemap_unregister_range(const void *start, size_t size);
+size_t pagemap_span(const t_zone *zone);
+t_zone *pagemap_lookup(const void *ptr);
+
+//=============================================================================
+// Statistics
+//=============================================================================
+
+// Per-thread event counters: allocations then frees by zone type, then reallocs.
+enum e_stat_counter {
+    STAT_ALLOCS = 0,
+    STAT_FREES = STAT_ALLOCS + ZONE_TYPES,
+    STAT_REALLOCS = STAT_FREES + ZONE_TYPES,
+    STAT_COUNTERS
+};
+
+enum e_stats_state {
+    STATS_UNINIT,
+    STATS_ACTIVE,
+    STATS_BUSY,
+    STATS_DETACHED
+};
+
+/**
+ * @brief Event counters of one thread, only written by that thread and summed by
+ * ft_malloc_stats() through the list of live threads.
+ */
+typedef struct s_thread_stats {
+    size_t                  counts[STAT_COUNTERS];
+    struct s_thread_stats   *next;
+    struct s_thread_stats   *prev;
+    int                     state;
+} t_thread_stats;
+
+extern __thread t_thread_stats g_thread_stats __attribute__((tls_model("initial-exec")));
+
+void stats_attach(size_t counter);
+void stats_fork(int phase);
+
+/**
+ * @brief Counts one event for the calling thread: a plain increment once the thread
+ * is on the list, published with a relaxed store for ft_malloc_stats().
+ */
+static inline void stats_count(size_t counter)
+{
+    t_thread_stats *ts = &g_thread_stats;
+
+    if (__builtin_expect(ts->state == STATS_ACTIVE, 1))
+        __atomic_store_n(&ts->counts[counter], ts->counts[counter] + 1, __ATOMIC_RELAXED);
+    else
+        stats_attach(counter);
+}
+
+//=============================================================================
+// Heap Profiler
+//=============================================================================
+
+/**
+ * @brief Sampling state of one thread: the bytes left before its next sample point,
+ * its random interval generator, and a flag set while it records a sample.
+ */
+typedef struct s_prof_thread {
+    ssize_t         countdown;
+    uint64_t        rng;
+    int             busy;
+} t_prof_thread;
+
+extern __thread t_prof_thread g_prof_thread __attribute__((tls_model("initial-exec")));
+
+void prof_sample(void *ptr, size_t size);
+void prof_forget(t_zone *zone, void *ptr);
+void prof_report_sites(t_out *out, size_t max);
+void prof_fork(int phase);
+
+/**
+ * @brief Counts 'size' allocated bytes against the calling thread's sample countdown.
+ * Call prof_sample() with the allocation when it returns non-zero.
+ */
+static inline int prof_tick(size_t size)
+{
+    t_prof_thread *pt = &g_prof_thread;
+
+    pt->countdown -= (ssize_t)size;
+    return __builtin_expect(pt->countdown < 0, 0);
+}
+
+//=============================================================================
+// Thread Cache
+//=============================================================================
+
+// Allocations parked in a thread cache (or in quarantine) stay live in their zone;
+// their second word holds g_config.canary, the freed tag, so heap walks leave them
+// out (see snapshot_take()) and hardened builds recognize double frees.
+#define FREED_TAG(ptr)      (((uintptr_t *)(ptr))[1])
+#define FREED_TAGGED(ptr)   (FREED_TAG(ptr) == g_config.canary)
+
+void *tcache_malloc(size_t aligned_size);
+int tcache_free(void *ptr);
 
 
 
@@ -1,11 +1,11 @@
+#define _GNU_SOURCE
 #include "libft_malloc.h"
 #include <unistd.h>
 #include <sys/mman.h>
 #include <stdio.h>
 #include <string.h>
-
-t_zone *g_zones = NULL;
-pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+#include <stdint.h>
+#include <errno.h>
 
 //=============================================================================
 // Helper Functions
@@ -13,197 +13,719 @@ pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 
 /**
- * @brief Creates a new memory zone using mmap and initializes its first block.
+ * @brief Maps 'size' bytes of fresh memory, on huge pages if 'huge' asks for them.
  *
- * This function maps a new memory region of the given size, sets the zone type, and
- * initializes the first block header covering the remainder of the zone.
+ * THP_MADVISE over-maps by HUGE_PAGE_SIZE minus a page, unmaps the misaligned head
+ * and the excess tail so the range starts on a huge page boundary, and advises it
+ * with MADV_HUGEPAGE: every whole huge page of it can then be backed by a single
+ * TLB entry. THP_HUGETLB first asks for MAP_HUGETLB pages, which only exist when
+ * the administrator reserved some, and falls back to THP_MADVISE; 'size' must then
+ * be a multiple of HUGE_PAGE_SIZE.
+ *
+ * @param size Length of the mapping in bytes.
+ * @param huge THP_OFF, THP_MADVISE or THP_HUGETLB.
+ * @return Start of the mapping, or NULL if mmap fails.
+ */
+static void *map_pages(size_t size, int huge)
+{
+    size_t slack = HUGE_PAGE_SIZE - g_config.page_size;
+    char *map;
+    char *start;
+
+#ifdef MAP_HUGETLB
+    if (huge == THP_HUGETLB)
+    {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (map != MAP_FAILED)
+            return map;
+    }
+#endif
+    if (huge == THP_OFF)
+    {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return map == MAP_FAILED ? NULL : map;
+    }
+    size = (size + g_config.page_size - 1) & ~(g_config.page_size - 1);
+    map = mmap(NULL, size + slack, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return NULL;
+    start = (char *)(((uintptr_t)map + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (start > map)
+        munmap(map, start - map);
+    if (start + size < map + size + slack)
+        munmap(start + size, map + size + slack - (start + size));
+#ifdef MADV_HUGEPAGE
+    madvise(start, size, MADV_HUGEPAGE);
+#endif
+    return start;
+}
+
+/**
+ * @brief Maps a new memory zone and registers it in the page map.
+ *
+ * This function maps a new memory region of the given size, sets the zone type and
+ * owning arena, and records its pages so get_zone_for_ptr() can find it. Blocks are
+ * left to the caller. With huge pages enabled (g_config.thp), SMALL zones and LARGE
+ * zones of at least HUGE_PAGE_SIZE are mapped through map_pages(); MAP_HUGETLB is
+ * kept for SMALL zones, which are never trimmed or remapped.
  *
+ * @param arena Arena the zone belongs to.
  * @param type The type of the memory zone (TINY, SMALL, or LARGE).
  * @param zone_size The total size in bytes for the new zone.
- * @return Pointer to the created t_zone structure, or NULL if mmap fails.
+ * @return Pointer to the mapped t_zone structure, or NULL if mmap fails.
  */
-static t_zone *create_zone(t_zone_type type, size_t zone_size)
+t_zone *map_zone(t_arena *arena, t_zone_type type, size_t zone_size)
 {
-    t_zone *zone = mmap(NULL, zone_size, PROT_READ | PROT_WRITE,
-                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (zone == MAP_FAILED)
+    int huge = THP_OFF;
+    t_zone *zone;
+
+    if (type == SMALL)
+        huge = g_config.thp;
+    else if (type == LARGE && zone_size >= HUGE_PAGE_SIZE && g_config.thp != THP_OFF)
+        huge = THP_MADVISE;
+    zone = map_pages(zone_size, huge);
+    if (!zone)
         return NULL;
     zone->type = type;
+    zone->prof_samples = 0;
     zone->size = zone_size;
+    zone->arena = arena;
     zone->next = NULL;
-    zone->blocks = (t_block *)((char *)zone + sizeof(t_zone));
-    zone->blocks->size = zone_size - sizeof(t_zone) - BLOCK_SIZE;
-    zone->blocks->free = 1;
-    zone->blocks->next = NULL;
-    zone->blocks->prev = NULL;
+    zone->prev = NULL;
+    zone->blocks = (t_block *)((char *)zone + ZONE_HEADER_SIZE);
+    if (pagemap_register(zone) != 0)
+    {
+        munmap(zone, zone_size);
+        return NULL;
+    }
+    vg_zone_map(zone);
     return zone;
 }
 
+/**
+ * @brief Payload actually reserved for a SMALL request of 'size' bytes.
+ *
+ * @param size Requested size.
+ * @return 'size' padded so that the chunk (payload plus BLOCK_OVERHEAD) is a
+ *         multiple of the SMALL granule; BLOCK_ROUND(size) with the default one.
+ */
+size_t small_size(size_t size)
+{
+    size_t granule = g_config.small_granule;
+
+    return ((size + BLOCK_OVERHEAD + granule - 1) & ~(granule - 1)) - BLOCK_OVERHEAD;
+}
 
 /**
- * @brief Adds a memory zone to the global zones list.
+ * @brief Creates a new SMALL memory zone using mmap and initializes its first block.
  *
- * This function prepends the provided zone to the global linked list of zones.
+ * This function maps a new memory region of the given size, sets the zone type, and
+ * initializes the first block header covering the remainder of the zone. The block
+ * is placed so that its payload starts on a g_config.small_granule boundary, with a
+ * size that keeps every block carved from it on that boundary.
+ *
+ * @param arena Arena the zone belongs to.
+ * @param type The type of the memory zone (TINY, SMALL, or LARGE).
+ * @param zone_size The total size in bytes for the new zone.
+ * @return Pointer to the created t_zone structure, or NULL if mmap fails.
+ */
+static t_zone *create_zone(t_arena *arena, t_zone_type type, size_t zone_size)
+{
+    size_t granule = g_config.small_granule;
+    size_t offset = ((ZONE_HEADER_SIZE + BLOCK_SIZE + granule - 1) & ~(granule - 1)) - BLOCK_SIZE;
+    t_zone *zone = map_zone(arena, type, zone_size);
+
+    if (!zone)
+        return NULL;
+    // The last payload ends BLOCK_SIZE - BLOCK_OVERHEAD bytes past its chunk.
+    zone->blocks = (t_block *)((char *)zone + offset);
+    vg_defined(zone->blocks, BLOCK_SIZE);
+    zone->blocks->prev_size = 0;
+    zone->blocks->head = BLOCK_SEAL(zone->blocks,
+                                    ((zone_size - offset - BLOCK_OVERHEAD) & ~(granule - 1))
+                                    | BLOCK_FREE | BLOCK_FIRST | BLOCK_LAST);
+    return zone;
+}
+
+
+/**
+ * @brief Adds a memory zone to the zone list of its arena.
+ *
+ * This function prepends the provided zone to the linked list of zones of its arena.
  *
  * @param zone Pointer to the memory zone to be added.
  */
-static void add_zone(t_zone *zone)
+void add_zone(t_zone *zone)
 {
-    zone->next = g_zones;
-    g_zones = zone;
+    ARENA_STAT_ADD(zone->arena->zone_count[zone->type], 1);
+    ARENA_STAT_ADD(zone->arena->mapped[zone->type], zone->size);
+    zone->prev = NULL;
+    zone->next = zone->arena->zones;
+    if (zone->arena->zones)
+        zone->arena->zones->prev = zone;
+    zone->arena->zones = zone;
 }
 
 /**
- * @brief Removes a memory zone from the global zones list.
+ * @brief Removes a memory zone from the zone list of its arena.
  *
- * This function searches the global zones list and removes the specified zone.
+ * The list is doubly linked, so the zone is unlinked in constant time.
  *
  * @param zone Pointer to the memory zone to be removed.
  */
 void remove_zone(t_zone *zone)
 {
-    t_zone *prev = NULL;
-    t_zone *curr = g_zones;
-    while (curr)
-    {
-        if (curr == zone)
-        {
-            if (prev)
-                prev->next = curr->next;
-            else
-                g_zones = curr->next;
-            break;
-        }
-        prev = curr;
-        curr = curr->next;
-    }
+    ARENA_STAT_ADD(zone->arena->zone_count[zone->type], -1);
+    ARENA_STAT_ADD(zone->arena->mapped[zone->type], -zone->size);
+    if (zone->prev)
+        zone->prev->next = zone->next;
+    else
+        zone->arena->zones = zone->next;
+    if (zone->next)
+        zone->next->prev = zone->prev;
+}
+
+/**
+ * @brief Unlinks a zone, drops it from the page map and returns it to the OS.
+ * The caller must hold the arena lock.
+ *
+ * @param zone Pointer to the memory zone to be released.
+ */
+void release_zone(t_zone *zone)
+{
+    remove_zone(zone);
+    pagemap_unregister(zone);
+    vg_zone_unmap(zone);
+    munmap(zone, zone->size);
 }
 
 /**
- * @brief Finds a free block within a zone that fits at least 'size' bytes.
+ * @brief Sets the payload size and flags of a block and tells its successor
+ * whether it is free. Caller holds the arena lock.
  *
- * Iterates through the linked list of blocks in a given zone and returns the first
- * block that is free and has enough size.
+ * The successor's boundary tag is only written for a free block: while the block
+ * is allocated that word is the end of its payload. Hardened builds check the seal
+ * of the successor before sealing it again, so a corrupted header is never laundered.
  *
- * @param zone Pointer to the memory zone to search.
- * @param size The minimum number of bytes required.
- * @return Pointer to a suitable free block, or NULL if none is found.
+ * @param block Block to update.
+ * @param payload New payload size (a chunk size minus BLOCK_OVERHEAD).
+ * @param flags BLOCK_* flags of the block, BLOCK_PREV_FREE included.
  */
-static t_block *find_free_block_in_zone(t_zone *zone, size_t size)
+void block_set(t_block *block, size_t payload, size_t flags)
 {
-    t_block *block = zone->blocks;
-    while (block)
+    size_t chunk = payload + BLOCK_OVERHEAD;
+    t_block *next = (t_block *)((char *)block + chunk);
+
+    vg_defined(&block->head, sizeof(block->head));
+    block->head = BLOCK_SEAL(block, chunk | flags);
+    if (flags & BLOCK_LAST)
+        return;
+    vg_defined(&next->head, sizeof(next->head));
+#ifdef FT_MALLOC_HARDENED
+    if (!BLOCK_SEALED(next))
+        harden_fail("heap", "corrupted block header at", next + 1, NULL, NULL);
+#endif
+    if (flags & BLOCK_FREE)
     {
-        if (block->free && block->size >= size)
-            return block;
-        block = block->next;
+        vg_defined(&next->prev_size, sizeof(next->prev_size));
+        next->prev_size = chunk;
+        next->head = BLOCK_SEAL(next, (next->head & BLOCK_HEAD_MASK) | BLOCK_PREV_FREE);
     }
-    return NULL;
+    else
+        next->head = BLOCK_SEAL(next, next->head & BLOCK_HEAD_MASK & ~BLOCK_PREV_FREE);
+}
+
+//=============================================================================
+// Size-Class Bins
+//=============================================================================
+
+/**
+ * @brief Maps a free SMALL block size to its bin.
+ *
+ * Bins follow the table built by config_init(): one class per ALIGNMENT bytes up
+ * to 64, then four geometric classes per doubling up to the SMALL threshold. The
+ * last bin collects free blocks larger than that (typically the untouched tail of
+ * a zone).
+ *
+ * @param size Payload size of the block.
+ * @return Index into the arena bins.
+ */
+static size_t bin_index(size_t size)
+{
+    if (size > g_config.small_max)
+        return SMALL_BINS - 1;
+    return g_config.small_bins[(size - 1) / ALIGNMENT];
 }
 
+/**
+ * @brief Pushes a free block onto the bin matching its size. Caller holds the arena lock.
+ *
+ * @param arena Arena owning the block.
+ * @param block Free block to insert.
+ */
+void bin_insert(t_arena *arena, t_block *block)
+{
+    size_t bin = bin_index(BLOCK_PAYLOAD(block));
+    t_free_links *links = FREE_LINKS(block);
+
+    vg_defined(links, sizeof(*links));
+    links->prev_free = NULL;
+    links->next_free = arena->bins[bin];
+    if (arena->bins[bin])
+        FREE_LINKS(arena->bins[bin])->prev_free = block;
+    arena->bins[bin] = block;
+    arena->bin_map |= 1UL << bin;
+    ARENA_STAT_ADD(arena->small_free, BLOCK_CHUNK(block));
+}
+
+/**
+ * @brief Unlinks a free block from its bin. Caller holds the arena lock.
+ *
+ * @param arena Arena owning the block.
+ * @param block Free block to remove; its size must not have changed since insertion.
+ */
+void bin_remove(t_arena *arena, t_block *block)
+{
+    size_t bin = bin_index(BLOCK_PAYLOAD(block));
+    t_free_links *links = FREE_LINKS(block);
+
+#ifdef FT_MALLOC_HARDENED
+    if (!BLOCK_SEALED(block) || !BLOCK_IS_FREE(block))
+        harden_fail("heap", "corrupted free block at", block + 1, NULL, NULL);
+#endif
+    if (links->prev_free)
+        FREE_LINKS(links->prev_free)->next_free = links->next_free;
+    else
+        arena->bins[bin] = links->next_free;
+    if (links->next_free)
+        FREE_LINKS(links->next_free)->prev_free = links->prev_free;
+    if (!arena->bins[bin])
+        arena->bin_map &= ~(1UL << bin);
+    ARENA_STAT_ADD(arena->small_free, -BLOCK_CHUNK(block));
+}
 
 /**
- * @brief Finds a free block of a given type in the global zones that fits 'size' bytes.
+ * @brief Takes a free SMALL block of at least 'size' bytes out of the bins.
  *
- * Searches the global zones list for a zone of the specified type and then finds a free block
- * within that zone that can accommodate the requested size.
+ * A class spans sizes on both sides of the request, so the request's own bin is
+ * searched first fit; past BIN_SCAN blocks too small, the first non-empty bin of a
+ * larger class is taken instead, found in O(1) through the arena bin map. Only when
+ * there is none is the rest of the bin walked, which is always the case for the
+ * last bin: carving a block anywhere beats mapping a new zone.
  *
- * @param type The type of zone (TINY, SMALL, or LARGE) to search in.
+ * @param arena Arena to search.
  * @param size The number of bytes required.
- * @param zone_found Optional output parameter to return the zone where the block was found.
- * @return Pointer to a free block, or NULL if no suitable block exists.
+ * @return Pointer to a free block removed from its bin, or NULL if none fits.
  */
-static t_block *find_free_block(t_zone_type type, size_t size, t_zone **zone_found)
+static t_block *take_free_block(t_arena *arena, size_t size)
 {
-    t_zone *zone = g_zones;
-    t_block *block = NULL;
+    size_t bin = bin_index(size);
+    unsigned long map = arena->bin_map & ~((2UL << bin) - 1);
+    unsigned int misses = 0;
+    t_block *block;
 
-    while (zone)
+    for (block = arena->bins[bin]; block; block = FREE_LINKS(block)->next_free)
     {
-        if (zone->type == type)
+        if (BLOCK_PAYLOAD(block) >= size)
+            break;
+        if (map && ++misses == BIN_SCAN)
         {
-            block = find_free_block_in_zone(zone, size);
-            if (block)
-            {
-                if (zone_found)
-                    *zone_found = zone;
-                return block;
-            }
+            block = NULL;
+            break;
         }
-        zone = zone->next;
     }
-    return NULL;
+    if (!block)
+    {
+        if (!map)
+            return NULL;
+        block = arena->bins[__builtin_ctzl(map)];
+    }
+    bin_remove(arena, block);
+    return block;
 }
 
 /**
  * @brief Splits a free block if it is considerably larger than requested into an allocated block and a residual free block.
  *
- * If the free block has significantly more space than requested, it is split into:
+ * If the block has enough room left for the smallest SMALL block, it is split into:
  * - An allocated block of exactly 'size' bytes.
- * - A new free block that contains the remaining space.
+ * - A new free block that contains the remaining space, merged with a free successor
+ *   and inserted into its bin.
  *
- * @param block Pointer to the free block to be split.
- * @param size The requested allocation size.
+ * @param arena Arena owning the block.
+ * @param block Pointer to the allocated block to be split.
+ * @param size The payload to keep, as returned by small_size().
  */
-static void split_block(t_block *block, size_t size)
+static void split_block(t_arena *arena, t_block *block, size_t size)
 {
-    if (block->size >= size + BLOCK_SIZE + 8)
+    size_t payload = BLOCK_PAYLOAD(block);
+    t_block *new_block;
+
+    if (payload >= size + BLOCK_OVERHEAD + small_size(g_config.tiny_max + 1))
     {
-        t_block *new_block = (t_block *)((char *)block + BLOCK_SIZE + size);
-        new_block->size = block->size - size - BLOCK_SIZE;
-        new_block->free = 1;
-        new_block->next = block->next;
-        new_block->prev = block;
-        if (new_block->next)
-            new_block->next->prev = new_block;
-        block->size = size;
-        block->next = new_block;
+        new_block = (t_block *)((char *)block + size + BLOCK_OVERHEAD);
+        block_set(new_block, payload - size - BLOCK_OVERHEAD, BLOCK_FREE | (block->head & BLOCK_LAST));
+        block_set(block, size, block->head & (BLOCK_FLAGS & ~BLOCK_LAST));
+        bin_insert(arena, coalesce(arena, new_block));
     }
 }
 
+/**
+ * @brief Resizes an allocated SMALL block in place. Caller holds the arena lock.
+ *
+ * Growing absorbs the successor when it is free and large enough; the surplus
+ * (or, when shrinking, the tail) is split off as a new free block.
+ *
+ * @param arena Arena owning the block.
+ * @param block Allocated block to resize.
+ * @param size New payload size, above the TINY threshold.
+ * @return 1 if the block now holds at least 'size' bytes, 0 if it could not grow.
+ */
+static int resize_block(t_arena *arena, t_block *block, size_t size)
+{
+    t_block *next = BLOCK_NEXT(block);
+    size_t payload = BLOCK_PAYLOAD(block);
+
+    size = small_size(size);
+    if (payload < size)
+    {
+        if (!next || !BLOCK_IS_FREE(next) || payload + BLOCK_CHUNK(next) < size)
+            return 0;
+        bin_remove(arena, next);
+        block_set(block, payload + BLOCK_CHUNK(next),
+                  (block->head & (BLOCK_FIRST | BLOCK_PREV_FREE)) | (next->head & BLOCK_LAST));
+    }
+    split_block(arena, block, size);
+    return 1;
+}
+
 /**
  * @brief Determines the memory zone that contains the given pointer.
  *
- * Iterates through the global zones list to find which zone holds the address specified by ptr.
+ * Looks the pointer's page up in the radix page map, so the cost does not depend on
+ * the number of zones. Safe to call without any lock for pointers the caller owns.
  *
  * @param ptr Pointer assumed to be part of a memory block header.
  * @return Pointer to the corresponding zone, or NULL if not found.
  */
 t_zone *get_zone_for_ptr(void *ptr)
 {
-    t_zone *zone = g_zones;
-    while (zone)
+    t_zone *zone = pagemap_lookup(ptr);
+
+    if (zone && (char *)ptr > (char *)zone && (char *)ptr < ((char *)zone + zone->size))
+        return zone;
+    return NULL;
+}
+
+/**
+ * @brief Merges a free block with its immediate neighbours if they are free.
+ *
+ * Only the immediate neighbours (found through the chunk size and boundary tag)
+ * are looked at, so the cost is constant whatever the zone occupancy. Merged neighbours are unlinked from their
+ * bins; the caller inserts the returned block into its bin.
+ *
+ * @param arena Arena owning the block.
+ * @param block Free block that is not in any bin.
+ * @return The merged block (the previous neighbour if it absorbed 'block').
+ */
+t_block *coalesce(t_arena *arena, t_block *block)
+{
+    t_block *next = BLOCK_NEXT(block);
+    t_block *prev = BLOCK_PREV(block);
+
+    if (next && BLOCK_IS_FREE(next))
     {
-        if ((char *)ptr > (char *)zone && (char *)ptr < ((char *)zone + zone->size))
-            return zone;
-        zone = zone->next;
+        bin_remove(arena, next);
+        block_set(block, BLOCK_PAYLOAD(block) + BLOCK_CHUNK(next),
+                  (block->head & (BLOCK_FREE | BLOCK_FIRST | BLOCK_PREV_FREE))
+                  | (next->head & BLOCK_LAST));
     }
+    if (prev && BLOCK_IS_FREE(prev))
+    {
+        bin_remove(arena, prev);
+        block_set(prev, BLOCK_PAYLOAD(prev) + BLOCK_CHUNK(block),
+                  (prev->head & (BLOCK_FREE | BLOCK_FIRST)) | (block->head & BLOCK_LAST));
+        block = prev;
+    }
+    return block;
+}
+
+/**
+ * @brief Carves a SMALL or LARGE block of 'aligned_size' bytes out of the zones.
+ *
+ * SMALL requests are served from the size-class bins, creating a new zone via mmap
+ * when no free block fits (taking the whole block of a spare zone takes it out of
+ * the spare count); LARGE allocations always get their own zone.
+ * The caller must hold the arena lock.
+ *
+ * @param arena Arena to allocate from.
+ * @param aligned_size Number of bytes to allocate, from REQUEST_SIZE(), above
+ *                     the TINY threshold; SMALL requests are padded with small_size().
+ * @return Pointer to the allocated block header, or NULL if mmap fails.
+ */
+t_block *alloc_block(t_arena *arena, size_t aligned_size)
+{
+    t_zone *zone;
+    t_block *block;
+
+    if (aligned_size > SMALL_PAYLOAD_MAX)
+    {
+        if (aligned_size > REQUEST_MAX)
+        {
+            errno = ENOMEM;
+            return NULL;
+        }
+        aligned_size = BLOCK_ROUND(aligned_size);
+        zone = map_zone(arena, LARGE, LARGE_ZONE_SIZE(ZONE_HEADER_SIZE + BLOCK_SIZE + aligned_size));
+        if (!zone)
+            return NULL;
+        harden_guard(zone, 1);
+        vg_defined(zone->blocks, BLOCK_SIZE);
+        zone->blocks->prev_size = 0;
+        block_set(zone->blocks, aligned_size, BLOCK_FIRST | BLOCK_LAST);
+        add_zone(zone);
+        return zone->blocks;
+    }
+    aligned_size = small_size(aligned_size);
+    block = take_free_block(arena, aligned_size);
+    if (block && BLOCK_WHOLE_ZONE(block))
+        arena->small_spares--;
+    if (!block)
+    {
+        zone = create_zone(arena, SMALL, g_config.small_zone_size);
+        if (!zone)
+            return NULL;
+        add_zone(zone);
+        block = zone->blocks;
+    }
+    block_set(block, BLOCK_PAYLOAD(block), block->head & BLOCK_FLAGS & ~BLOCK_FREE);
+    split_block(arena, block, aligned_size);
+    return block;
+}
+
+/**
+ * @brief Resizes a LARGE zone with mremap so the payload is never copied by hand.
+ * Caller holds the arena lock.
+ *
+ * The mapping is first resized in place, which leaves the page map alone: only the
+ * head of a LARGE zone is in it (see pagemap_span()). When the neighbouring address
+ * space is taken, a destination is reserved and its head registered before the pages
+ * are moved there with MREMAP_FIXED, so a failure at any step leaves the original
+ * zone untouched. The block keeps its offset in the zone (see alloc_aligned()).
+ * Page map entries are always cleared before their pages go back to the kernel,
+ * since another arena may map and register them as soon as they are released.
+ *
+ * @param zone LARGE zone to resize.
+ * @param aligned_size New payload size, from REQUEST_SIZE() and above SMALL_PAYLOAD_MAX.
+ * @return The (possibly moved) zone, or NULL if it could not be resized.
+ */
+static t_zone *resize_large(t_zone *zone, size_t aligned_size)
+{
+#ifdef MREMAP_FIXED
+    size_t old_total = zone->size;
+    size_t offset = (char *)zone->blocks - (char *)zone;
+    size_t new_total;
+    void *dst;
+
+    if (aligned_size > REQUEST_MAX - offset)
+        return NULL;
+    new_total = LARGE_ZONE_SIZE(offset + BLOCK_SIZE + aligned_size);
+    // Only the head of the zone is in the page map, and it stays where it is.
+    if (mremap(zone, old_total, new_total, 0) != MAP_FAILED)
+    {
+        zone->size = new_total;
+        ARENA_STAT_ADD(zone->arena->mapped[LARGE], new_total - old_total);
+        vg_zone_move(zone, zone, old_total);
+        block_set(zone->blocks, aligned_size, BLOCK_FIRST | BLOCK_LAST);
+        return zone;
+    }
+    if (new_total <= old_total)
+        return NULL;
+    dst = mmap(NULL, new_total, PROT_NONE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (dst == MAP_FAILED)
+        return NULL;
+    if (pagemap_register_range(dst, pagemap_span(zone), (t_zone *)dst) != 0)
+    {
+        munmap(dst, new_total);
+        return NULL;
+    }
+    remove_zone(zone);
+    pagemap_unregister(zone);
+    if (mremap(zone, old_total, new_total, MREMAP_MAYMOVE | MREMAP_FIXED, dst) == MAP_FAILED)
+    {
+        // The old pages keep their leaves, so registering them again cannot fail.
+        pagemap_register(zone);
+        add_zone(zone);
+        pagemap_unregister_range(dst, pagemap_span(zone));
+        munmap(dst, new_total);
+        return NULL;
+    }
+    ((t_zone *)dst)->size = new_total;
+    vg_zone_move(zone, dst, old_total);
+    zone = dst;
+    zone->blocks = (t_block *)((char *)zone + offset);
+    block_set(zone->blocks, aligned_size, BLOCK_FIRST | BLOCK_LAST);
+    add_zone(zone);
+    return zone;
+#else
+    (void)zone;
+    (void)aligned_size;
     return NULL;
+#endif
 }
 
 /**
- * @brief Coalesces adjacent free blocks within the specified zone.
+ * @brief Allocates 'aligned_size' bytes from a TINY slab or a SMALL/LARGE block.
+ * The caller must hold the arena lock.
  *
- * Merges contiguous free blocks into a single larger free block in order to
- * reduce fragmentation.
+ * @param arena Arena to allocate from.
+ * @param aligned_size Number of bytes to allocate, from REQUEST_SIZE().
+ * @return Pointer to the user memory, or NULL if mmap fails.
+ */
+void *alloc_ptr(t_arena *arena, size_t aligned_size)
+{
+    t_block *block;
+
+    if (aligned_size <= g_config.tiny_max)
+        return slab_alloc(arena, aligned_size);
+    block = alloc_block(arena, aligned_size);
+    if (!block)
+        return NULL;
+    return (void *)(block + 1);
+}
+
+/**
+ * @brief Moves the start of a freshly allocated block forward to 'user'.
+ * Caller holds the arena lock.
+ *
+ * In a SMALL zone the skipped bytes become a free block of their own; in a LARGE
+ * zone the block header simply moves, and the pages left past the end of the new
+ * block are unmapped.
  *
- * @param zone Pointer to the memory zone where coalescing is to be performed.
+ * @param zone Zone owning the block.
+ * @param block Allocated block to shift.
+ * @param user New user pointer, at least BLOCK_SIZE + sizeof(t_free_links) bytes
+ *             past block + 1 (or block + 1 itself for a LARGE zone, which then only
+ *             gets trimmed).
+ * @param aligned_size Payload the shifted block must keep (small_size() padded for
+ *                     SMALL zones).
+ * @return Header of the shifted block, or NULL if the page map could not follow a
+ *         LARGE one (the block is then left where it was).
  */
-void coalesce(t_zone *zone)
+static t_block *shift_block(t_zone *zone, t_block *block, char *user, size_t aligned_size)
 {
-    t_block *block = zone->blocks;
-    while (block)
+    t_block *shifted = (t_block *)user - 1;
+    size_t gap = (char *)shifted - (char *)block;
+    size_t page = g_config.page_size;
+    size_t old_total = zone->size;
+    uintptr_t end;
+    uintptr_t old_end;
+
+    if (zone->type == LARGE)
     {
-        if (block->free && block->next && block->next->free)
+        // The page map has to reach the new payload start before the header moves.
+        end = ((uintptr_t)zone + pagemap_span(zone) + page - 1) & ~(page - 1);
+        if (end <= (uintptr_t)user
+            && pagemap_register_range((void *)end, (uintptr_t)user + 1 - end, zone) != 0)
+            return NULL;
+        zone->blocks = shifted;
+        vg_defined(shifted, BLOCK_SIZE);
+        shifted->prev_size = 0;
+        block_set(shifted, aligned_size, BLOCK_FIRST | BLOCK_LAST);
+        end = ((uintptr_t)zone + LARGE_ZONE_SIZE((char *)user + aligned_size - (char *)zone)
+               + page - 1) & ~(page - 1);
+        old_end = ((uintptr_t)zone + old_total + page - 1) & ~(page - 1);
+        if (end < old_end)
         {
-            block->size += BLOCK_SIZE + block->next->size;
-            block->next = block->next->next;
-            if (block->next)
-                block->next->prev = block;
-            continue;
+            zone->size = LARGE_ZONE_SIZE((char *)user + aligned_size - (char *)zone);
+            ARENA_STAT_ADD(zone->arena->mapped[LARGE], zone->size - old_total);
+            munmap((void *)end, old_end - end);
+            vg_zone_move(zone, zone, old_total);
+            harden_guard(zone, 1);
         }
-        block = block->next;
+        return shifted;
     }
+    block_set(shifted, BLOCK_PAYLOAD(block) - gap, block->head & BLOCK_LAST);
+    block_set(block, gap - BLOCK_OVERHEAD, BLOCK_FREE | (block->head & (BLOCK_FIRST | BLOCK_PREV_FREE)));
+    bin_insert(zone->arena, coalesce(zone->arena, block));
+    split_block(zone->arena, shifted, aligned_size);
+    return shifted;
+}
+
+/**
+ * @brief Allocates 'aligned_size' bytes whose address is a multiple of 'alignment'.
+ * The caller must hold the arena lock.
+ *
+ * TINY requests with an alignment up to 64 come from a slab whose object size is a
+ * multiple of the alignment, since slab objects start on a cache line. Anything
+ * else carves a SMALL or LARGE block with 'alignment' plus one minimal free block
+ * of slack, and moves the block start to the first aligned address that leaves
+ * room for the leading free block; the slack past the block is split off (SMALL)
+ * or unmapped (LARGE) again. The alignment is raised to the SMALL granule so the
+ * leading free block keeps the SMALL layout.
+ *
+ * @param arena Arena to allocate from.
+ * @param alignment Power of two greater than ALIGNMENT.
+ * @param aligned_size Number of bytes to allocate, from REQUEST_SIZE().
+ * @return Pointer to the user memory, or NULL if the request cannot be served.
+ */
+void *alloc_aligned(t_arena *arena, size_t alignment, size_t aligned_size)
+{
+    size_t tiny_size = (aligned_size + alignment - 1) & ~(alignment - 1);
+    size_t slack;
+    size_t request;
+    t_zone *zone;
+    t_block *block;
+    t_block *shifted;
+    uintptr_t user;
+    uintptr_t target;
+
+    if (alignment <= 64 && tiny_size <= g_config.tiny_max)
+        return slab_alloc(arena, tiny_size);
+    if (alignment < g_config.small_granule)
+        alignment = g_config.small_granule;
+    slack = alignment + BLOCK_SIZE + sizeof(t_free_links);
+    if (slack > REQUEST_MAX || aligned_size > REQUEST_MAX - slack)
+        return NULL;
+    aligned_size = small_size(aligned_size > g_config.tiny_max ? aligned_size : g_config.tiny_max + 1);
+    request = aligned_size + slack;
+    block = alloc_block(arena, request);
+    if (!block)
+        return NULL;
+    user = (uintptr_t)(block + 1);
+    target = (user + alignment - 1) & ~(alignment - 1);
+    if (target == user && request <= SMALL_PAYLOAD_MAX)
+    {
+        split_block(arena, block, aligned_size);
+        return (void *)user;
+    }
+    while (target != user && target - user < BLOCK_SIZE + sizeof(t_free_links))
+        target += alignment;
+    zone = get_zone_for_ptr(block);
+    shifted = shift_block(zone, block, (char *)target, aligned_size);
+    if (!shifted)
+    {
+        release_zone(zone);
+        return NULL;
+    }
+    return (void *)(shifted + 1);
+}
+
+/**
+ * @brief Returns the usable size of an allocation.
+ *
+ * @param zone Zone owning the allocation.
+ * @param ptr Pointer to the user memory.
+ * @return The slab object size for TINY allocations, the block size otherwise.
+ */
+size_t alloc_size(t_zone *zone, void *ptr)
+{
+    if (zone->type == TINY)
+        return zone->slab.obj_size;
+    return BLOCK_PAYLOAD((t_block *)ptr - 1);
 }
 
 //=============================================================================
@@ -213,94 +735,127 @@ void coalesce(t_zone *zone)
 /**
  * @brief Allocates "size" bytes of memory.
  *
- * This allocator first aligns the requested size to 8 bytes. Depending on the size,
- * it allocates from a TINY, SMALL, or LARGE memory zone. If no suitable free block is available,
- * it creates a new zone via mmap (except for LARGE allocations, which get their own).
+ * This allocator first rounds the requested size with REQUEST_SIZE(): TINY sizes
+ * to ALIGNMENT (16) bytes, SMALL and LARGE ones to a block payload, which keeps
+ * every returned pointer 16-byte aligned. TINY and SMALL requests
+ * are served from the calling thread's cache when possible, so the common case does
+ * not take any lock; everything else goes through alloc_ptr() under the lock of the
+ * calling thread's arena. Served bytes count against the heap profiler's sample
+ * countdown (prof_tick()).
  *
  * @param size Number of bytes to allocate.
  * @return Pointer to the allocated memory, or NULL if allocation fails or size is 0.
  */
 void *malloc(size_t size)
 {
-    t_zone *zone_found = NULL;
-    t_block *block = NULL;
+    t_arena *arena;
+    void *ptr;
     size_t aligned_size;
 
+    CONFIG_ENSURE();
     if (size == 0)
         size = 1;
-    
-    // Align size to 8 bytes.
-    aligned_size = (size + 7) & ~7;
-
-    pthread_mutex_lock(&g_mutex);
+    if (size > REQUEST_MAX)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    aligned_size = REQUEST_SIZE(size);
+    stats_count(STAT_ALLOCS + SIZE_TYPE(aligned_size));
 
-    if (aligned_size <= TINY_MAX)
+    ptr = tcache_malloc(aligned_size);
+    if (!ptr)
     {
-        block = find_free_block(TINY, aligned_size, &zone_found);
-        if (!block)
-        {
-            zone_found = create_zone(TINY, TINY_ZONE_SIZE);
-            if (!zone_found) {
-                pthread_mutex_unlock(&g_mutex);
-                return NULL;
-            }
-            add_zone(zone_found);
-            block = zone_found->blocks;
-        }
+        arena = arena_lock();
+        ptr = alloc_ptr(arena, aligned_size);
+        pthread_mutex_unlock(&arena->mutex);
     }
-    else if (aligned_size <= SMALL_MAX)
+    if (ptr && prof_tick(aligned_size))
+        prof_sample(ptr, aligned_size);
+    vg_alloc(ptr, 0);
+    return ptr;
+}
+
+/**
+ * @brief Resizes or migrates an allocation. The caller must hold the lock of the
+ * zone's arena, which also serves the new block if the allocation migrates.
+ *
+ * In-place resizing is tried first (SMALL successor absorption, LARGE mremap); when
+ * it is not possible the allocation migrates to a new block of the right class, the
+ * data is copied and the old allocation released, all within the same critical
+ * section. Copies under the lock stay small: the only LARGE-to-LARGE copy left is
+ * the fallback for a failed mremap.
+ *
+ * A sampled allocation leaves the heap profile only once it has been resized, so a
+ * failed realloc keeps its sample; realloc() then profiles the result like a new
+ * allocation. The zone is still mapped at that point, which is why it is done here.
+ *
+ * @param zone Zone owning the allocation.
+ * @param ptr Pointer to the user memory.
+ * @param old_size Usable size of the allocation.
+ * @param aligned_size New size, from REQUEST_SIZE().
+ * @return Pointer to the resized allocation, or NULL if allocation fails (ptr is
+ *         then left untouched).
+ */
+static void *realloc_locked(t_zone *zone, void *ptr, size_t old_size, size_t aligned_size)
+{
+    t_zone *moved;
+    void *new_ptr;
+
+    if (zone->type == SMALL && aligned_size > g_config.tiny_max && aligned_size <= SMALL_PAYLOAD_MAX
+        && resize_block(zone->arena, (t_block *)ptr - 1, aligned_size))
     {
-        block = find_free_block(SMALL, aligned_size, &zone_found);
-        if (!block)
-        {
-            zone_found = create_zone(SMALL, SMALL_ZONE_SIZE);
-            if (!zone_found) {
-                pthread_mutex_unlock(&g_mutex);
-                return NULL;
-            }
-            add_zone(zone_found);
-            block = zone_found->blocks;
-        }
+        vg_resize(ptr, ptr, old_size);
+        if (__builtin_expect(zone->prof_samples != 0, 0))
+            prof_forget(zone, ptr);
+        return ptr;
     }
-    else
+    if (zone->type == LARGE && aligned_size > SMALL_PAYLOAD_MAX)
     {
-        size_t total_size = sizeof(t_zone) + BLOCK_SIZE + aligned_size;
-        t_zone *zone = mmap(NULL, total_size, PROT_READ | PROT_WRITE,
-                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-        if (zone == MAP_FAILED) {
-            pthread_mutex_unlock(&g_mutex);
-            return NULL;
+        // mremap() cannot move a zone split by its guard page.
+        harden_guard(zone, 0);
+        moved = resize_large(zone, aligned_size);
+        harden_guard(moved ? moved : zone, 1);
+        if (moved)
+        {
+            vg_resize(ptr, moved->blocks + 1, old_size);
+            // The header moved with the zone, its sample count included.
+            if (__builtin_expect(moved->prof_samples != 0, 0))
+                prof_forget(moved, ptr);
+            return (void *)(moved->blocks + 1);
         }
-        zone->type = LARGE;
-        zone->size = total_size;
-        zone->next = NULL;
-        zone->blocks = (t_block *)((char *)zone + sizeof(t_zone));
-        zone->blocks->size = aligned_size;
-        zone->blocks->free = 0;
-        zone->blocks->next = NULL;
-        zone->blocks->prev = NULL;
-        add_zone(zone);
-        pthread_mutex_unlock(&g_mutex);
-        return (void *)(zone->blocks + 1);
     }
-    split_block(block, aligned_size);
-    block->free = 0;
-    // void *user_ptr = (void*)(block + 1);
-    // VALGRIND_MALLOCLIKE_BLOCK(user_ptr, aligned_size, 0, 0);
-    
-    pthread_mutex_unlock(&g_mutex);
-    return (void *)(block + 1);
+    new_ptr = alloc_ptr(zone->arena, aligned_size);
+    if (!new_ptr)
+        return NULL;
+    vg_alloc(new_ptr, 0);
+    memcpy(new_ptr, ptr, (old_size < aligned_size) ? old_size : aligned_size);
+    vg_free(ptr);
+    if (__builtin_expect(zone->prof_samples != 0, 0))
+        prof_forget(zone, ptr);
+    release_ptr(zone, ptr);
+    return new_ptr;
 }
 
 /**
  * @brief Reallocates the given memory block to a new size.
  *
- * If the new size is less than or equal to the current block's size, the block is
- * split (if possible). Otherwise, a new block is allocated, the data copied, and the old block freed.
+ * Each class is resized where it lives when possible:
+ * - SMALL blocks shrink by splitting and grow by absorbing a free successor.
+ * - LARGE zones are resized (and moved if needed) with mremap, without copying.
+ * - TINY objects and SMALL blocks shrinking to TINY sizes keep their slot.
+ * Otherwise the allocation migrates to the class matching the new size. A LARGE
+ * allocation shrinking to SMALL or TINY size always migrates, which gives its
+ * mapping back.
+ *
+ * Keeping a slot needs no lock, and a TINY object moving to a bigger TINY/SMALL class
+ * goes through the thread cache. Everything else takes the arena lock exactly once, so the
+ * block headers are never read or split while another thread coalesces around them.
  *
  * @param ptr Pointer to the existing memory block (or NULL, in which case ft_malloc is called).
  * @param size The new size in bytes for the reallocation.
- * @return Pointer to the reallocated memory block, or NULL if allocation fails.
+ * @return Pointer to the reallocated memory block, or NULL if allocation fails or
+ *         ptr was not returned by this allocator.
  */
 void *realloc(void *ptr, size_t size)
 {
@@ -312,20 +867,68 @@ void *realloc(void *ptr, size_t size)
         return NULL;
     }
     
-    t_block *block = (t_block *)ptr - 1;
-    size_t aligned_size = (size + 7) & ~7;
-    
-    if (block->size >= aligned_size)
+    if (size > REQUEST_MAX)
     {
-        split_block(block, aligned_size);
-        return ptr;
+        errno = ENOMEM;
+        return NULL;
     }
-    
-    void *new_ptr = malloc(size);
-    if (!new_ptr)
+
+    size_t aligned_size = REQUEST_SIZE(size);
+#ifdef FT_MALLOC_HARDENED
+    t_zone *zone = harden_check(ptr, __builtin_return_address(0), "realloc()");
+#else
+    t_zone *zone = get_zone_for_ptr(ptr);
+#endif
+    t_arena *arena;
+    size_t old_size;
+    void *new_ptr;
+
+    if (!zone)
         return NULL;
-    size_t copy_size = (block->size < aligned_size) ? block->size : aligned_size;
-    memcpy(new_ptr, ptr, copy_size);
-    free(ptr);
+    stats_count(STAT_REALLOCS);
+    // The usable size is only ever changed by the thread owning the allocation.
+    old_size = alloc_size(zone, ptr);
+    if (zone->type != LARGE && old_size >= aligned_size
+        && !(zone->type == SMALL && aligned_size > g_config.tiny_max))
+        return ptr;
+    if (zone->type == TINY && aligned_size <= SMALL_PAYLOAD_MAX)
+        new_ptr = tcache_malloc(aligned_size);
+    else
+        new_ptr = NULL;
+    if (new_ptr)
+    {
+        vg_alloc(new_ptr, 0);
+        memcpy(new_ptr, ptr, old_size);
+        free(ptr);
+    }
+    else
+    {
+        arena = zone->arena;
+        pthread_mutex_lock(&arena->mutex);
+        new_ptr = realloc_locked(zone, ptr, old_size, aligned_size);
+        pthread_mutex_unlock(&arena->mutex);
+    }
+    if (new_ptr && prof_tick(aligned_size))
+        prof_sample(new_ptr, aligned_size);
     return new_ptr;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Returns the number of usable bytes in the allocation pointed to by ptr.
+ *
+ * @param ptr Pointer returned by this allocator, or NULL.
+ * @return The usable size (at least the requested size), or 0 for NULL and
+ *         pointers that belong to no zone.
+ */
+size_t malloc_usable_size(void *ptr)
+{
+    t_zone *zone;
+    size_t size = 0;
+
+    if (!ptr)
+        return 0;
+    zone = get_zone_for_ptr(ptr);
+    if (zone)
+        size = alloc_size(zone, ptr);
+    return size;
+}
@@ -0,0 +1,134 @@
+#include "libft_malloc.h"
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+
+/**
+ * @brief Allocates 'size' bytes aligned on 'alignment', for every aligned variant.
+ *
+ * Alignments up to ALIGNMENT are what malloc() returns anyway; larger ones are carved out
+ * of the zones by alloc_aligned().
+ *
+ * @param alignment Power of two.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the allocated memory, or NULL with errno set to ENOMEM if
+ *         allocation fails.
+ */
+static void *aligned_ptr(size_t alignment, size_t size)
+{
+    t_arena *arena;
+    void *ptr;
+
+    CONFIG_ENSURE();
+    if (alignment <= ALIGNMENT)
+        return malloc(size);
+    if (size > REQUEST_MAX)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (size == 0)
+        size = 1;
+    stats_count(STAT_ALLOCS + SIZE_TYPE(REQUEST_SIZE(size)));
+    arena = arena_lock();
+    ptr = alloc_aligned(arena, alignment, REQUEST_SIZE(size));
+    pthread_mutex_unlock(&arena->mutex);
+    if (ptr && prof_tick(REQUEST_SIZE(size)))
+        prof_sample(ptr, REQUEST_SIZE(size));
+    vg_alloc(ptr, 0);
+    if (!ptr)
+        errno = ENOMEM;
+    return ptr;
+}
+
+/**
+ * @brief Allocates 'size' bytes aligned on 'alignment' and stores the pointer in
+ * *memptr.
+ *
+ * @param memptr Where to store the allocation.
+ * @param alignment Power of two, multiple of sizeof(void *).
+ * @param size Number of bytes to allocate.
+ * @return 0 on success, EINVAL for a bad alignment, ENOMEM if allocation fails.
+ *         errno is left untouched either way, as POSIX requires.
+ */
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    int saved_errno = errno;
+    void *ptr;
+
+    if (alignment % sizeof(void *) || (alignment & (alignment - 1)) || !alignment)
+        return EINVAL;
+    ptr = aligned_ptr(alignment, size);
+    if (!ptr)
+    {
+        errno = saved_errno;
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+/**
+ * @brief C11 aligned allocation.
+ *
+ * @param alignment Power of two.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the allocated memory, or NULL with errno set to EINVAL for a bad
+ *         alignment or ENOMEM if allocation fails.
+ */
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    if (!alignment || (alignment & (alignment - 1)))
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    return aligned_ptr(alignment, size);
+}
+
+/**
+ * @brief Legacy aligned allocation. Like glibc, an alignment that is not a power of
+ * two is rounded up to the next one.
+ *
+ * @param alignment Requested alignment.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the allocated memory, or NULL with errno set on failure.
+ */
+void *memalign(size_t alignment, size_t size)
+{
+    if (alignment > SIZE_MAX / 2 + 1)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (alignment & (alignment - 1))
+        alignment = 1UL << (64 - __builtin_clzl(alignment));
+    return aligned_ptr(alignment, size);
+}
+
+/**
+ * @brief Allocates 'size' bytes aligned on a page boundary.
+ */
+void *valloc(size_t size)
+{
+    CONFIG_ENSURE();
+    return memalign(g_config.page_size, size);
+}
+
+/**
+ * @brief Allocates 'size' bytes rounded up to a whole number of pages, aligned on a
+ * page boundary.
+ */
+void *pvalloc(size_t size)
+{
+    size_t page;
+
+    CONFIG_ENSURE();
+    page = g_config.page_size;
+    if (size > SIZE_MAX - page)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return memalign(page, (size + page - 1) & ~(page - 1));
+}
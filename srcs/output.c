@@ -0,0 +1,145 @@
+#define _GNU_SOURCE
+#include "libft_malloc.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+const char *const g_zone_names[ZONE_TYPES] = {"TINY", "SMALL", "LARGE"};
+
+/**
+ * @brief Starts buffered output to 'fd'. Nothing is written until the buffer fills
+ * up or out_flush() is called.
+ */
+void out_init(t_out *out, int fd)
+{
+    out->fd = fd;
+    out->len = 0;
+}
+
+/**
+ * @brief Writes the buffered bytes with write(2), retrying after signals and short
+ * writes; output is dropped if the fd fails.
+ */
+void out_flush(t_out *out)
+{
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < out->len)
+    {
+        n = write(out->fd, out->buf + done, out->len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    out->len = 0;
+}
+
+/**
+ * @brief Appends 'len' bytes.
+ */
+void out_mem(t_out *out, const char *data, size_t len)
+{
+    size_t chunk;
+
+    while (len)
+    {
+        if (out->len == OUT_BUFFER_SIZE)
+            out_flush(out);
+        chunk = OUT_BUFFER_SIZE - out->len;
+        if (chunk > len)
+            chunk = len;
+        for (size_t i = 0; i < chunk; i++)
+            out->buf[out->len + i] = data[i];
+        out->len += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+void out_str(t_out *out, const char *str)
+{
+    size_t len = 0;
+
+    while (str[len])
+        len++;
+    out_mem(out, str, len);
+}
+
+/**
+ * @brief Appends 'value' in decimal.
+ */
+void out_dec(t_out *out, size_t value)
+{
+    char digits[20];
+    size_t pos = sizeof(digits);
+
+    do
+        digits[--pos] = '0' + value % 10;
+    while (value /= 10);
+    out_mem(out, digits + pos, sizeof(digits) - pos);
+}
+
+/**
+ * @brief Appends 'value' in hexadecimal, padded with zeros to 'width' digits.
+ *
+ * @param upper Non-zero for A-F, zero for a-f.
+ */
+void out_hex(t_out *out, size_t value, size_t width, int upper)
+{
+    const char *set = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char digits[16];
+    size_t pos = sizeof(digits);
+
+    do
+    {
+        digits[--pos] = set[value & 15];
+        value >>= 4;
+    } while (pos > 0 && (value || sizeof(digits) - pos < width));
+    out_mem(out, digits + pos, sizeof(digits) - pos);
+}
+
+/**
+ * @brief Appends a pointer the way printf's %p does: 0x-prefixed lowercase hex,
+ * or (nil).
+ */
+void out_ptr(t_out *out, const void *ptr)
+{
+    if (!ptr)
+    {
+        out_str(out, "(nil)");
+        return;
+    }
+    out_str(out, "0x");
+    out_hex(out, (size_t)ptr, 1, 0);
+}
+
+/**
+ * @brief Appends a code address by name: the symbol and offset when the dynamic symbol
+ * table knows it, the object file and offset otherwise, the bare address last.
+ */
+void out_symbol(t_out *out, void *frame)
+{
+    Dl_info info;
+    const char *name;
+    uintptr_t base;
+
+    if (!dladdr(frame, &info) || !info.dli_fname)
+    {
+        out_ptr(out, frame);
+        return;
+    }
+    name = info.dli_sname;
+    base = (uintptr_t)info.dli_saddr;
+    if (!name)
+    {
+        name = strrchr(info.dli_fname, '/') ? strrchr(info.dli_fname, '/') + 1 : info.dli_fname;
+        base = (uintptr_t)info.dli_fbase;
+    }
+    out_str(out, *name ? name : "?");
+    out_str(out, "+0x");
+    out_hex(out, (uintptr_t)frame - base, 1, 0);
+}
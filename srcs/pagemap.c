@@ -0,0 +1,150 @@
+#include "libft_malloc.h"
+#include <stdint.h>
+#include <sys/mman.h>
+
+// Pages are g_config.page_size bytes; the root is sized for the smallest page size
+// supported, so larger pages only leave the top of it unused.
+#define PAGEMAP_MIN_SHIFT   12
+#define PAGEMAP_ADDR_BITS   48
+#define PAGEMAP_LEAF_BITS   18
+#define PAGEMAP_ROOT_BITS   (PAGEMAP_ADDR_BITS - PAGEMAP_MIN_SHIFT - PAGEMAP_LEAF_BITS)
+#define PAGEMAP_LEAF_MASK   ((1UL << PAGEMAP_LEAF_BITS) - 1)
+
+/**
+ * @brief Two-level radix map from page number to owning zone.
+ *
+ * The root is indexed by the high bits of the page number and points to leaves of
+ * 2^PAGEMAP_LEAF_BITS zone pointers, mapped on first use and never released.
+ * Writers hold the lock of the arena owning the zone, so entries of one page are
+ * never written concurrently; leaves shared by several arenas are installed with a
+ * compare-and-swap. Readers are lock-free, which is safe because a zone's entries
+ * only change while nobody can legitimately hold a pointer into it.
+ *
+ * Every page of a TINY or SMALL zone is recorded, since any of them may hold an
+ * allocation. A LARGE zone holds a single one, only ever looked up by its start, so
+ * only the pages up to it are (see pagemap_span()): mapping, resizing and moving a
+ * LARGE zone cost the same whatever its size.
+ */
+static t_zone **g_pagemap[1UL << PAGEMAP_ROOT_BITS];
+
+/**
+ * @brief Points every page in [first, last] at 'value'.
+ *
+ * @param first First page number.
+ * @param last Last page number (inclusive).
+ * @param value Zone to store, or NULL to clear the entries.
+ * @return 0 on success, -1 if a leaf could not be mapped.
+ */
+static int pagemap_set(uintptr_t first, uintptr_t last, t_zone *value)
+{
+    uintptr_t page = first;
+    t_zone **leaf;
+    t_zone **installed;
+
+    for (; page <= last; page++)
+    {
+        leaf = __atomic_load_n(&g_pagemap[page >> PAGEMAP_LEAF_BITS], __ATOMIC_ACQUIRE);
+        if (!leaf)
+        {
+            if (!value)
+                continue;
+            leaf = mmap(NULL, sizeof(t_zone *) << PAGEMAP_LEAF_BITS,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (leaf == MAP_FAILED)
+                return -1;
+            installed = NULL;
+            if (!__atomic_compare_exchange_n(&g_pagemap[page >> PAGEMAP_LEAF_BITS],
+                                             &installed, leaf, 0, __ATOMIC_ACQ_REL,
+                                             __ATOMIC_ACQUIRE))
+            {
+                munmap(leaf, sizeof(t_zone *) << PAGEMAP_LEAF_BITS);
+                leaf = installed;
+            }
+        }
+        __atomic_store_n(&leaf[page & PAGEMAP_LEAF_MASK], value, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+#define FIRST_PAGE(start)       ((uintptr_t)(start) >> g_config.page_shift)
+#define LAST_PAGE(start, size)  (((uintptr_t)(start) + (size) - 1) >> g_config.page_shift)
+
+/**
+ * @brief Bytes at the start of a zone recorded in the page map: the whole zone for
+ * TINY and SMALL zones, up to the first byte of the payload for LARGE ones.
+ *
+ * @param zone Zone whose type and first block are set.
+ */
+size_t pagemap_span(const t_zone *zone)
+{
+    if (zone->type != LARGE)
+        return zone->size;
+    return (size_t)((char *)(zone->blocks + 1) - (char *)zone) + 1;
+}
+
+/**
+ * @brief Records the pages of a fresh mapping as owned by 'zone'. Caller holds the
+ * arena lock.
+ *
+ * @param start Start of the mapping.
+ * @param size Length of the mapping in bytes.
+ * @param zone Zone to record (the zone header may not be written yet).
+ * @return 0 on success, -1 on failure (the range is left unregistered).
+ */
+int pagemap_register_range(const void *start, size_t size, t_zone *zone)
+{
+    if (pagemap_set(FIRST_PAGE(start), LAST_PAGE(start, size), zone) == 0)
+        return 0;
+    pagemap_set(FIRST_PAGE(start), LAST_PAGE(start, size), NULL);
+    return -1;
+}
+
+/**
+ * @brief Clears the pages of a mapping about to disappear. Caller holds the arena lock.
+ */
+void pagemap_unregister_range(const void *start, size_t size)
+{
+    pagemap_set(FIRST_PAGE(start), LAST_PAGE(start, size), NULL);
+}
+
+/**
+ * @brief Records a freshly mapped zone in the page map. Caller holds the arena lock.
+ *
+ * @param zone Zone to register; its type, size and first block must already be set.
+ * @return 0 on success, -1 on failure (the map is left without the zone).
+ */
+int pagemap_register(t_zone *zone)
+{
+    return pagemap_register_range(zone, pagemap_span(zone), zone);
+}
+
+/**
+ * @brief Removes a zone from the page map before it is unmapped. Caller holds the
+ * arena lock.
+ *
+ * @param zone Zone to unregister.
+ */
+void pagemap_unregister(t_zone *zone)
+{
+    pagemap_unregister_range(zone, pagemap_span(zone));
+}
+
+/**
+ * @brief Returns the zone registered for the page containing 'ptr', without locking.
+ *
+ * @param ptr Any address.
+ * @return Pointer to the zone, or NULL if the page belongs to no zone.
+ */
+t_zone *pagemap_lookup(const void *ptr)
+{
+    uintptr_t page = (uintptr_t)ptr >> g_config.page_shift;
+    t_zone **leaf;
+
+    if (page >> (PAGEMAP_ROOT_BITS + PAGEMAP_LEAF_BITS))
+        return NULL;
+    leaf = __atomic_load_n(&g_pagemap[page >> PAGEMAP_LEAF_BITS], __ATOMIC_ACQUIRE);
+    if (!leaf)
+        return NULL;
+    return __atomic_load_n(&leaf[page & PAGEMAP_LEAF_MASK], __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,554 @@
+#define _GNU_SOURCE
+#include "libft_malloc.h"
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <link.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Call sites the profiler tells apart, and sampled allocations it tracks at once.
+// Both tables are mapped once, on the first sample; past 3/4 occupancy new stacks
+// and samples are dropped rather than grown into.
+#define PROF_STACKS     4096
+#define PROF_LIVE       (1UL << 17)
+// Frames kept per stack, and extra ones captured to make up for the allocator's own.
+#define PROF_DEPTH      32
+#define PROF_SKIP_MAX   8
+// Frames of a call site shown by the leak report.
+#define PROF_REPORT_FRAMES  4
+
+/**
+ * @brief A call site: its stack, the sampled allocations still live and all of those
+ * made since the start, both scaled back to estimated object and byte counts.
+ */
+typedef struct s_prof_stack {
+    uint64_t        hash;
+    unsigned int    depth;              // 0 for an unused slot
+    size_t          live_count;
+    size_t          live_bytes;
+    size_t          alloc_count;
+    size_t          alloc_bytes;
+    void            *frames[PROF_DEPTH];    // innermost first
+} t_prof_stack;
+
+/**
+ * @brief A sampled allocation, so free() can take it back out of its stack.
+ */
+typedef struct s_prof_live {
+    void            *ptr;               // NULL for an unused slot
+    unsigned int    stack;
+    size_t          count;
+    size_t          bytes;
+} t_prof_live;
+
+typedef struct s_profiler {
+    pthread_mutex_t lock;
+    t_prof_stack    *stacks;
+    t_prof_live     *live;
+    size_t          stack_count;
+    size_t          live_count;
+    unsigned long   live_seq;           // odd while prof_forget() moves live entries
+    uintptr_t       text_start;         // the allocator's own code, left out of stacks
+    uintptr_t       text_end;
+    int             ready;
+} t_profiler;
+
+__thread t_prof_thread g_prof_thread __attribute__((tls_model("initial-exec")));
+
+static t_profiler g_prof = {.lock = PTHREAD_MUTEX_INITIALIZER};
+static pthread_once_t g_prof_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief dl_iterate_phdr() callback: finds the executable segment holding this file.
+ */
+static int prof_find_text(struct dl_phdr_info *info, size_t size, void *data)
+{
+    uintptr_t self = (uintptr_t)&prof_sample;
+    const ElfW(Phdr) *phdr;
+    uintptr_t start;
+
+    (void)size;
+    (void)data;
+    for (int i = 0; i < info->dlpi_phnum; i++)
+    {
+        phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type != PT_LOAD || !(phdr->p_flags & PF_X))
+            continue;
+        start = info->dlpi_addr + phdr->p_vaddr;
+        if (self >= start && self < start + phdr->p_memsz)
+        {
+            g_prof.text_start = start;
+            g_prof.text_end = start + phdr->p_memsz;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Maps the tables, locates the allocator's code and primes backtrace(), once.
+ *
+ * glibc's backtrace() loads the unwinder with dlopen() on its first call, which
+ * allocates; afterwards it only walks the unwind tables. Priming it here, with the
+ * thread marked busy, keeps those allocations out of the profile and every later
+ * capture free of allocations.
+ */
+static void prof_init(void)
+{
+    void *frame;
+
+    g_prof.stacks = mmap(NULL, PROF_STACKS * sizeof(t_prof_stack), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    g_prof.live = mmap(NULL, PROF_LIVE * sizeof(t_prof_live), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (g_prof.stacks == MAP_FAILED || g_prof.live == MAP_FAILED)
+        return;
+    dl_iterate_phdr(prof_find_text, NULL);
+    backtrace(&frame, 1);
+    __atomic_store_n(&g_prof.ready, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Bytes to the next sample point: uniform in [1, 2 * prof_sample - 1], so
+ * sample points fall on average every g_config.prof_sample bytes without locking
+ * onto a periodic allocation pattern. xorshift64* on a per-thread state.
+ */
+static ssize_t prof_interval(t_prof_thread *pt)
+{
+    size_t period = g_config.prof_sample;
+
+    if (!pt->rng)
+        pt->rng = ((uintptr_t)pt ^ (uintptr_t)&period) * 0x9E3779B97F4A7C15ULL | 1;
+    pt->rng ^= pt->rng >> 12;
+    pt->rng ^= pt->rng << 25;
+    pt->rng ^= pt->rng >> 27;
+    if (period < 2)
+        return 1;
+    return 1 + (pt->rng * 0x2545F4914F6CDD1DULL) % (2 * period - 1);
+}
+
+static uint64_t prof_hash_frames(void *const *frames, int depth)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (int i = 0; i < depth; i++)
+        hash = (hash ^ (uintptr_t)frames[i]) * 0x100000001b3ULL;
+    return hash | 1;
+}
+
+static size_t prof_live_slot(const void *ptr)
+{
+    return (((uintptr_t)ptr >> 4) * 0x9E3779B97F4A7C15ULL >> 32) & (PROF_LIVE - 1);
+}
+
+/**
+ * @brief Finds the stack of 'frames', or claims a slot for it. Caller holds the lock.
+ *
+ * @return Index of the stack, or -1 if the table is full.
+ */
+static long prof_stack_find(void *const *frames, int depth)
+{
+    uint64_t hash = prof_hash_frames(frames, depth);
+    t_prof_stack *stack;
+    size_t i = hash & (PROF_STACKS - 1);
+
+    for (;; i = (i + 1) & (PROF_STACKS - 1))
+    {
+        stack = &g_prof.stacks[i];
+        if (!stack->depth)
+            break;
+        if (stack->hash == hash && stack->depth == (unsigned int)depth
+            && memcmp(stack->frames, frames, depth * sizeof(void *)) == 0)
+            return i;
+    }
+    if (g_prof.stack_count >= PROF_STACKS / 4 * 3)
+        return -1;
+    stack->hash = hash;
+    stack->depth = depth;
+    memcpy(stack->frames, frames, depth * sizeof(void *));
+    g_prof.stack_count++;
+    return i;
+}
+
+/**
+ * @brief Charges a sample to the stack of the calling thread and remembers 'ptr'.
+ */
+static void prof_record(void *ptr, size_t size, size_t bytes)
+{
+    void *raw[PROF_DEPTH + PROF_SKIP_MAX];
+    t_prof_live *live;
+    t_prof_stack *stack;
+    t_zone *zone = get_zone_for_ptr(ptr);
+    size_t count = bytes / size ? bytes / size : 1;
+    size_t slot;
+    long index;
+    int depth;
+    int skip = 0;
+
+    pthread_once(&g_prof_once, prof_init);
+    if (!__atomic_load_n(&g_prof.ready, __ATOMIC_ACQUIRE) || !zone)
+        return;
+    depth = backtrace(raw, PROF_DEPTH + PROF_SKIP_MAX);
+    while (skip < depth && skip < PROF_SKIP_MAX && (uintptr_t)raw[skip] >= g_prof.text_start
+           && (uintptr_t)raw[skip] < g_prof.text_end)
+        skip++;
+    depth = depth - skip > PROF_DEPTH ? PROF_DEPTH : depth - skip;
+    if (depth <= 0)
+        return;
+    pthread_mutex_lock(&g_prof.lock);
+    index = prof_stack_find(raw + skip, depth);
+    if (index < 0 || g_prof.live_count >= PROF_LIVE / 4 * 3)
+    {
+        pthread_mutex_unlock(&g_prof.lock);
+        return;
+    }
+    stack = &g_prof.stacks[index];
+    stack->alloc_count += count;
+    stack->alloc_bytes += bytes;
+    stack->live_count += count;
+    stack->live_bytes += bytes;
+    slot = prof_live_slot(ptr);
+    while (g_prof.live[slot].ptr)
+        slot = (slot + 1) & (PROF_LIVE - 1);
+    live = &g_prof.live[slot];
+    live->stack = index;
+    live->count = count;
+    live->bytes = bytes;
+    __atomic_store_n(&live->ptr, ptr, __ATOMIC_RELEASE);
+    g_prof.live_count++;
+    __atomic_fetch_add(&zone->prof_samples, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&g_prof.lock);
+}
+
+/**
+ * @brief Slow path of prof_tick(): the countdown of the calling thread went past one
+ * or more sample points while it allocated 'size' bytes at 'ptr'.
+ *
+ * Every sample point crossed stands for g_config.prof_sample bytes, so an allocation
+ * of s bytes is charged s bytes on average whatever its size, and large ones are
+ * almost always seen. With profiling off the countdown is pushed out of reach and
+ * the fast path never comes back here.
+ *
+ * @param ptr The allocation (failed ones are not charged).
+ * @param size Usable size of the allocation, from REQUEST_SIZE().
+ */
+void prof_sample(void *ptr, size_t size)
+{
+    t_prof_thread *pt = &g_prof_thread;
+    size_t points = 0;
+
+    if (!g_config.prof_sample)
+    {
+        pt->countdown = SSIZE_MAX;
+        return;
+    }
+    if (!pt->rng)
+    {
+        // A new thread starts a whole interval away from its first sample point.
+        pt->countdown += prof_interval(pt);
+        if (pt->countdown >= 0)
+            return;
+    }
+    // Intervals average g_config.prof_sample bytes: an allocation spanning many of
+    // them is charged for all but the last in one step rather than drawing each.
+    if ((size_t)-pt->countdown / g_config.prof_sample > 1)
+    {
+        points = (size_t)-pt->countdown / g_config.prof_sample - 1;
+        pt->countdown += (ssize_t)(points * g_config.prof_sample);
+    }
+    while (pt->countdown < 0)
+    {
+        pt->countdown += prof_interval(pt);
+        points++;
+    }
+    if (pt->busy)
+        return;
+    pt->busy = 1;
+    prof_record(ptr, size, points * g_config.prof_sample);
+    pt->busy = 0;
+}
+
+/**
+ * @brief Tells, without the lock, whether 'ptr' may be in the live table.
+ *
+ * An allocation is recorded before malloc() returns it, so a sampled one being
+ * freed is always in the table; the probe can only miss it if prof_forget() moved
+ * entries meanwhile, which 'live_seq' reveals (a seqlock).
+ *
+ * @return 0 if 'ptr' was not sampled, non-zero if the lock must be taken to know.
+ */
+static int prof_maybe_live(const void *ptr)
+{
+    unsigned long seq = __atomic_load_n(&g_prof.live_seq, __ATOMIC_ACQUIRE);
+    size_t slot = prof_live_slot(ptr);
+    void *entry;
+
+    if (seq & 1)
+        return 1;
+    while ((entry = __atomic_load_n(&g_prof.live[slot].ptr, __ATOMIC_RELAXED)) && entry != ptr)
+        slot = (slot + 1) & (PROF_LIVE - 1);
+    if (entry)
+        return 1;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&g_prof.live_seq, __ATOMIC_RELAXED) != seq;
+}
+
+/**
+ * @brief Takes a sampled allocation out of the live profile as it is freed or
+ * reallocated. Only called for zones holding samples; other pointers are ignored
+ * after a lock-free probe, so frees of unsampled allocations never serialize on
+ * the profile lock.
+ *
+ * The live table uses linear probing, so the entries after the removed one are
+ * shifted back instead of leaving a tombstone.
+ */
+void prof_forget(t_zone *zone, void *ptr)
+{
+    t_prof_stack *stack;
+    size_t hole;
+    size_t slot;
+    size_t home;
+
+    if (!prof_maybe_live(ptr))
+        return;
+    pthread_mutex_lock(&g_prof.lock);
+    slot = prof_live_slot(ptr);
+    while (g_prof.live[slot].ptr && g_prof.live[slot].ptr != ptr)
+        slot = (slot + 1) & (PROF_LIVE - 1);
+    if (!g_prof.live[slot].ptr)
+    {
+        pthread_mutex_unlock(&g_prof.lock);
+        return;
+    }
+    stack = &g_prof.stacks[g_prof.live[slot].stack];
+    stack->live_count -= g_prof.live[slot].count;
+    stack->live_bytes -= g_prof.live[slot].bytes;
+    __atomic_store_n(&g_prof.live_seq, g_prof.live_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    hole = slot;
+    for (slot = (hole + 1) & (PROF_LIVE - 1); g_prof.live[slot].ptr;
+         slot = (slot + 1) & (PROF_LIVE - 1))
+    {
+        home = prof_live_slot(g_prof.live[slot].ptr);
+        // Entries whose home lies cyclically in (hole, slot] stay where they are.
+        if (((slot - home) & (PROF_LIVE - 1)) < ((slot - hole) & (PROF_LIVE - 1)))
+            continue;
+        g_prof.live[hole].stack = g_prof.live[slot].stack;
+        g_prof.live[hole].count = g_prof.live[slot].count;
+        g_prof.live[hole].bytes = g_prof.live[slot].bytes;
+        __atomic_store_n(&g_prof.live[hole].ptr, g_prof.live[slot].ptr, __ATOMIC_RELAXED);
+        hole = slot;
+    }
+    __atomic_store_n(&g_prof.live[hole].ptr, NULL, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_prof.live_seq, g_prof.live_seq + 1, __ATOMIC_RELEASE);
+    g_prof.live_count--;
+    __atomic_fetch_sub(&zone->prof_samples, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&g_prof.lock);
+}
+
+/**
+ * @brief Fork handler of the profile lock (see fork_mutex()).
+ */
+void prof_fork(int phase)
+{
+    fork_mutex(&g_prof.lock, phase);
+}
+
+/**
+ * @brief Folded stacks, the input of flamegraph.pl and most flame graph viewers: one
+ * line per call site, frames outermost first separated by ';', then the bytes.
+ */
+static void dump_folded(t_out *out, const t_prof_stack *stacks, size_t count, int live)
+{
+    size_t bytes;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        bytes = live ? stacks[i].live_bytes : stacks[i].alloc_bytes;
+        if (!bytes)
+            continue;
+        for (unsigned int f = stacks[i].depth; f-- > 0;)
+        {
+            out_symbol(out, stacks[i].frames[f]);
+            out_str(out, f ? ";" : " ");
+        }
+        out_dec(out, bytes);
+        out_str(out, "\n");
+    }
+}
+
+static void dump_counts(t_out *out, size_t live_count, size_t live_bytes,
+                        size_t alloc_count, size_t alloc_bytes)
+{
+    out_dec(out, live_count);
+    out_str(out, ": ");
+    out_dec(out, live_bytes);
+    out_str(out, " [");
+    out_dec(out, alloc_count);
+    out_str(out, ": ");
+    out_dec(out, alloc_bytes);
+    out_str(out, "] @");
+}
+
+/**
+ * @brief The text heap profile of gperftools, which pprof reads: a totals line, one
+ * line per call site with its live then cumulative objects and bytes and its return
+ * addresses, then the memory map pprof symbolizes them with.
+ */
+static void dump_pprof(t_out *out, const t_prof_stack *stacks, size_t count)
+{
+    char buf[1024];
+    size_t totals[4] = {0};
+    ssize_t n;
+    int fd;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        totals[0] += stacks[i].live_count;
+        totals[1] += stacks[i].live_bytes;
+        totals[2] += stacks[i].alloc_count;
+        totals[3] += stacks[i].alloc_bytes;
+    }
+    out_str(out, "heap profile: ");
+    dump_counts(out, totals[0], totals[1], totals[2], totals[3]);
+    out_str(out, " heapprofile\n");
+    for (size_t i = 0; i < count; i++)
+    {
+        dump_counts(out, stacks[i].live_count, stacks[i].live_bytes,
+                    stacks[i].alloc_count, stacks[i].alloc_bytes);
+        for (unsigned int f = 0; f < stacks[i].depth; f++)
+        {
+            out_str(out, " ");
+            out_ptr(out, stacks[i].frames[f]);
+        }
+        out_str(out, "\n");
+    }
+    out_str(out, "\nMAPPED_LIBRARIES:\n");
+    fd = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    while ((n = read(fd, buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR))
+    {
+        if (n > 0)
+            out_mem(out, buf, n);
+    }
+    close(fd);
+}
+
+/**
+ * @brief Copies the call sites into a buffer of PROF_STACKS entries mapped for the
+ * occasion, under the profiler lock, which only sampled allocations and frees of
+ * sampled allocations wait for.
+ *
+ * @param count Set to the number of call sites copied.
+ * @return The copy, to unmap with prof_release(), or NULL if it could not be mapped.
+ */
+static t_prof_stack *prof_copy(size_t *count)
+{
+    t_prof_stack *copy = mmap(NULL, PROF_STACKS * sizeof(t_prof_stack), PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    *count = 0;
+    if (copy == MAP_FAILED)
+        return NULL;
+    pthread_mutex_lock(&g_prof.lock);
+    for (size_t i = 0; __atomic_load_n(&g_prof.ready, __ATOMIC_ACQUIRE) && i < PROF_STACKS; i++)
+    {
+        if (g_prof.stacks[i].depth)
+            copy[(*count)++] = g_prof.stacks[i];
+    }
+    pthread_mutex_unlock(&g_prof.lock);
+    return copy;
+}
+
+static void prof_release(t_prof_stack *copy)
+{
+    munmap(copy, PROF_STACKS * sizeof(t_prof_stack));
+}
+
+/**
+ * @brief Writes the sampled heap profile to 'fd' in one of the FT_MALLOC_PROF_*
+ * formats.
+ *
+ * Symbolization and output run on a copy of the call sites (see prof_copy()).
+ * Nothing is allocated and stdio is not involved. errno is preserved.
+ *
+ * @param fd File descriptor to write to.
+ * @param format FT_MALLOC_PROF_FOLDED_LIVE, FT_MALLOC_PROF_FOLDED_ALLOC or
+ *        FT_MALLOC_PROF_PPROF.
+ * @return 0 on success, -1 if profiling is off (prof_sample:0) or the copy could not
+ *         be mapped.
+ */
+int ft_malloc_prof_dump(int fd, int format)
+{
+    int saved_errno = errno;
+    t_prof_stack *copy;
+    size_t count;
+    t_out out;
+
+    CONFIG_ENSURE();
+    if (!g_config.prof_sample)
+        return -1;
+    copy = prof_copy(&count);
+    if (!copy)
+    {
+        errno = saved_errno;
+        return -1;
+    }
+    out_init(&out, fd);
+    if (format == FT_MALLOC_PROF_PPROF)
+        dump_pprof(&out, copy, count);
+    else
+        dump_folded(&out, copy, count, format == FT_MALLOC_PROF_FOLDED_LIVE);
+    out_flush(&out);
+    prof_release(copy);
+    errno = saved_errno;
+    return 0;
+}
+
+/**
+ * @brief Writes the 'max' call sites holding the most live bytes, innermost frames
+ * first, for the leak report. Writes nothing when profiling is off.
+ */
+void prof_report_sites(t_out *out, size_t max)
+{
+    t_prof_stack *copy;
+    t_prof_stack tmp;
+    size_t count;
+    size_t top;
+
+    if (!g_config.prof_sample || !(copy = prof_copy(&count)))
+        return;
+    out_str(out, "live bytes by allocation site (one sample every ");
+    out_dec(out, g_config.prof_sample);
+    out_str(out, " bytes, estimated):\n");
+    for (size_t i = 0; i < max && i < count; i++)
+    {
+        top = i;
+        for (size_t j = i + 1; j < count; j++)
+        {
+            if (copy[j].live_bytes > copy[top].live_bytes)
+                top = j;
+        }
+        if (!copy[top].live_bytes)
+            break;
+        tmp = copy[i];
+        copy[i] = copy[top];
+        copy[top] = tmp;
+        out_str(out, "  ");
+        out_dec(out, copy[i].live_bytes);
+        out_str(out, " bytes in ");
+        out_dec(out, copy[i].live_count);
+        out_str(out, " allocations at ");
+        for (unsigned int f = 0; f < copy[i].depth && f < PROF_REPORT_FRAMES; f++)
+        {
+            out_str(out, f ? " <- " : "");
+            out_symbol(out, copy[i].frames[f]);
+        }
+        out_str(out, "\n");
+    }
+    prof_release(copy);
+}
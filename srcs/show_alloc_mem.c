@@ -1,94 +1,171 @@
 #include "libft_malloc.h"
-#include <stdio.h>
-#include <sys/types.h>
+#include <errno.h>
+#include <string.h>
 #include <unistd.h>
-#include <pthread.h>
-
-#define MAX_ZONES_PER_TYPE 128
 
+static void print_range(t_out *out, uintptr_t start, size_t size)
+{
+    out_ptr(out, (void *)start);
+    out_str(out, " - ");
+    out_ptr(out, (void *)(start + size));
+    out_str(out, " : ");
+    out_dec(out, size);
+    out_str(out, " bytes\n");
+}
 
-static void sort_zones(t_zone *zones[], size_t count)
+/**
+ * @brief The show_alloc_mem() report: every zone with its live allocations, TINY
+ * zones first, then SMALL and LARGE ones, each in address order.
+ */
+static void dump_text(t_out *out, const t_snapshot *snap)
 {
-    size_t i, j;
-    t_zone *temp;
-    for (i = 1; i < count; i++) {
-        temp = zones[i];
-        j = i;
-        while (j > 0 && zones[j - 1] > temp) {
-            zones[j] = zones[j - 1];
-            j--;
+    const t_snapshot_entry *entry;
+    size_t total = 0;
+
+    out_str(out, "-------------------------------- SHOW_ALLOC_MEM -------------------------------------\n");
+    snapshot_report_busy(out, snap);
+    for (size_t i = 0; i < snap->count; i++) {
+        entry = &snap->entries[i];
+        if (entry->kind == SNAPSHOT_ZONE) {
+            out_str(out, g_zone_names[entry->type]);
+            out_str(out, " : ");
+            out_ptr(out, (void *)entry->addr);
+            out_str(out, "\n");
+            continue;
         }
-        zones[j] = temp;
+        print_range(out, entry->addr, entry->size);
+        total += entry->size;
     }
+    out_str(out, "Total : ");
+    out_dec(out, total);
+    out_str(out, " bytes\n\n\n\n\n");
 }
 
-static size_t collect_zones_by_type(enum e_zone_type type,
-                                    t_zone *out_zones[],
-                                    size_t max)
+static void json_addr(t_out *out, const char *key, uintptr_t addr, size_t size)
 {
-    size_t count = 0;
-    t_zone *zone = g_zones;
-
-    for (; zone && count < max; zone = zone->next) {
-        if (zone->type == type)
-            out_zones[count++] = zone;
-    }
-    return count;
+    out_str(out, key);
+    out_str(out, "\"addr\":\"");
+    out_ptr(out, (void *)addr);
+    out_str(out, "\",\"size\":");
+    out_dec(out, size);
 }
 
-static void print_blocks_in_zone(t_zone *zone, size_t *total)
+static void dump_json(t_out *out, const t_snapshot *snap)
 {
-    t_block *block = zone->blocks;
-    while (block) {
-        if (!block->free) {
-            void *start = (void *)(block + 1);
-            void *end   = (void *)((char *)start + block->size);
-            printf("%p - %p : %zu bytes\n", start, end, block->size);
-            *total += block->size;
+    const t_snapshot_entry *entry;
+    size_t allocations = 0;
+    size_t total = 0;
+    int first = 1;
+
+    out_str(out, "{\"zones\":[");
+    for (size_t i = 0; i < snap->count; i++) {
+        entry = &snap->entries[i];
+        if (entry->kind == SNAPSHOT_ZONE) {
+            out_str(out, i ? "]},\n" : "\n");
+            out_str(out, "{\"type\":\"");
+            out_str(out, g_zone_names[entry->type]);
+            json_addr(out, "\",", entry->addr, entry->size);
+            out_str(out, ",\"allocations\":[");
+            first = 1;
+            continue;
         }
-        block = block->next;
+        json_addr(out, first ? "{" : ",{", entry->addr, entry->size);
+        out_str(out, "}");
+        first = 0;
+        allocations++;
+        total += entry->size;
     }
+    out_str(out, snap->count ? "]}\n" : "");
+    out_str(out, "],\"skipped_arenas\":[");
+    first = 1;
+    for (size_t i = 0; i < arena_count(); i++) {
+        if (snap->arenas & (1ULL << i))
+            continue;
+        out_str(out, first ? "" : ",");
+        out_dec(out, i);
+        first = 0;
+    }
+    out_str(out, "],\"allocations\":");
+    out_dec(out, allocations);
+    out_str(out, ",\"bytes\":");
+    out_dec(out, total);
+    out_str(out, "}\n");
 }
 
-static void print_zones(const char *name,
-                        t_zone *zones[],
-                        size_t count,
-                        size_t *total)
+static void dump_binary(t_out *out, const t_snapshot *snap)
 {
-    for (size_t i = 0; i < count; i++) {
-        printf("%s : %p\n", name, (void *)zones[i]);
-        print_blocks_in_zone(zones[i], total);
+    size_t count = arena_count();
+    uint64_t all = count == 64 ? ~0ULL : (1ULL << count) - 1;
+    t_dump_header header;
+    t_dump_record record;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DUMP_MAGIC, sizeof(header.magic));
+    header.version = DUMP_VERSION;
+    header.record_size = sizeof(t_dump_record);
+    header.count = snap->count;
+    header.skipped_arenas = all & ~snap->arenas;
+    out_mem(out, (const char *)&header, sizeof(header));
+    for (size_t i = 0; i < snap->count; i++) {
+        record.addr = snap->entries[i].addr;
+        record.size = snap->entries[i].size;
+        record.kind = snap->entries[i].kind;
+        record.type = snap->entries[i].type;
+        out_mem(out, (const char *)&record, sizeof(record));
     }
 }
 
-void show_alloc_mem(void)
+/**
+ * @brief Writes a heap map to 'fd' in one of the FT_MALLOC_DUMP_* formats.
+ *
+ * The arenas are only locked while snapshot_take() copies the zone and block
+ * metadata; sorting and formatting run on the copy, so allocating threads are
+ * never held up by the output. Output goes through a stack buffer and write(2):
+ * nothing is allocated, stdio is not involved, and the dump may be produced from
+ * a signal handler. errno is preserved.
+ *
+ * @param fd File descriptor to write to.
+ * @param format FT_MALLOC_DUMP_TEXT, FT_MALLOC_DUMP_JSON or FT_MALLOC_DUMP_BINARY.
+ * @return 0 on success, -1 if the snapshot buffer could not be mapped.
+ */
+int ft_malloc_dump(int fd, int format)
 {
-    printf("-------------------------------- SHOW_ALLOC_MEM -------------------------------------\n");
+    int saved_errno = errno;
+    t_snapshot snap;
+    t_out out;
 
-    size_t total = 0;
-    t_zone *tiny_zones[MAX_ZONES_PER_TYPE];
-    t_zone *small_zones[MAX_ZONES_PER_TYPE];
-    t_zone *large_zones[MAX_ZONES_PER_TYPE];
-
-    pthread_mutex_lock(&g_mutex);
-
-    size_t tiny_count  = collect_zones_by_type(TINY,  tiny_zones,  MAX_ZONES_PER_TYPE);
-    size_t small_count = collect_zones_by_type(SMALL, small_zones, MAX_ZONES_PER_TYPE);
-    size_t large_count = collect_zones_by_type(LARGE, large_zones, MAX_ZONES_PER_TYPE);
-
-    sort_zones(tiny_zones,  tiny_count);
-    sort_zones(small_zones, small_count);
-    sort_zones(large_zones, large_count);
+    if (snapshot_take(&snap) != 0) {
+        errno = saved_errno;
+        return -1;
+    }
+    out_init(&out, fd);
+    if (format == FT_MALLOC_DUMP_JSON)
+        dump_json(&out, &snap);
+    else if (format == FT_MALLOC_DUMP_BINARY)
+        dump_binary(&out, &snap);
+    else
+        dump_text(&out, &snap);
+    out_flush(&out);
+    snapshot_release(&snap);
+    errno = saved_errno;
+    return 0;
+}
 
-    if (tiny_count > 0)
-        print_zones("TINY",  tiny_zones,  tiny_count,  &total);
-    if (small_count > 0)
-        print_zones("SMALL", small_zones, small_count, &total);
-    if (large_count > 0)
-        print_zones("LARGE", large_zones, large_count, &total);
+/**
+ * @brief Writes every live allocation, zone by zone in address order, to 'fd'
+ * (see ft_malloc_dump()).
+ *
+ * @param fd File descriptor to write to.
+ */
+void show_alloc_mem_fd(int fd)
+{
+    static const char failed[] = "show_alloc_mem: cannot map the snapshot buffer\n";
 
-    printf("Total : %zu bytes\n", total);
-    printf("\n\n\n\n");
+    if (ft_malloc_dump(fd, FT_MALLOC_DUMP_TEXT) != 0)
+        write(fd, failed, sizeof(failed) - 1);
+}
 
-    pthread_mutex_unlock(&g_mutex);
-}
\ No newline at end of file
+void show_alloc_mem(void)
+{
+    show_alloc_mem_fd(STDOUT_FILENO);
+}
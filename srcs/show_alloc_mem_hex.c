@@ -1,50 +1,101 @@
 #include "libft_malloc.h"
-#include <stdio.h>
-#include <pthread.h>
-
-// Helper to print a line of hex bytes with address
-static void print_hex_line(const unsigned char *data, size_t len, const void *addr) {
-    printf("%p  ", addr);
-    for (size_t i = 0; i < len; ++i) {
-        printf("%02X ", data[i]);
+#include <errno.h>
+#include <unistd.h>
+
+#define HEX_LINE_BYTES  16
+// Bytes copied out of the heap per critical section.
+#define HEX_CHUNK_BYTES 1024
+
+// Dump a copied piece of a block in hex, HEX_LINE_BYTES bytes per line, each line
+// prefixed with the address the bytes were read from
+static void hex_dump_chunk(t_out *out, const unsigned char *data, size_t size, uintptr_t addr) {
+    for (size_t offset = 0; offset < size; offset += HEX_LINE_BYTES) {
+        size_t line_len = (size - offset >= HEX_LINE_BYTES) ? HEX_LINE_BYTES : (size - offset);
+        out_ptr(out, (void *)(addr + offset));
+        out_str(out, "  ");
+        for (size_t i = 0; i < line_len; ++i) {
+            out_hex(out, data[offset + i], 2, 1);
+            out_str(out, " ");
+        }
+        out_str(out, "\n");
     }
-    printf("\n");
 }
 
-// Dump the contents of a block in hex, 16 bytes per line
-static void hex_dump_block(const void *start, size_t size) {
-    const unsigned char *data = (const unsigned char *)start;
-    size_t offset = 0;
-    while (offset < size) {
-        size_t line_len = (size - offset >= 16) ? 16 : (size - offset);
-        print_hex_line(data + offset, line_len, data + offset);
-        offset += line_len;
+// Dump one allocation, copied out a chunk at a time; stops if it gets freed.
+// Returns -1 once an arena stays busy: the contents of later blocks are skipped.
+static int hex_dump_allocation(t_out *out, const t_snapshot_entry *entry, int busy) {
+    unsigned char chunk[HEX_CHUNK_BYTES];
+    size_t len;
+
+    out_str(out, "Block at ");
+    out_ptr(out, (void *)entry->addr);
+    out_str(out, " - ");
+    out_dec(out, entry->size);
+    out_str(out, " bytes:\n");
+    if (busy)
+        return -1;
+    for (size_t offset = 0; offset < entry->size; offset += len) {
+        len = entry->size - offset < HEX_CHUNK_BYTES ? entry->size - offset : HEX_CHUNK_BYTES;
+        switch (snapshot_read(entry, offset, chunk, len)) {
+        case 0:
+            hex_dump_chunk(out, chunk, len, entry->addr + offset);
+            break;
+        case -1:
+            out_str(out, "(freed during the dump)\n");
+            return 0;
+        default:
+            out_str(out, "(arena busy, contents skipped)\n");
+            return -1;
+        }
     }
+    return 0;
+}
+
+static void hex_dump_zone(t_out *out, const t_snapshot_entry *entry) {
+    out_str(out, g_zone_names[entry->type]);
+    out_str(out, " zone at ");
+    out_ptr(out, (void *)entry->addr);
+    out_str(out, " (size ");
+    out_dec(out, entry->size);
+    out_str(out, "):\n");
 }
 
 /**
- * show_alloc_mem_hex - prints a hexadecimal dump of all allocated blocks
- * in all zones (TINY, SMALL, LARGE).
+ * show_alloc_mem_hex_fd - writes a hexadecimal dump of all allocated blocks in all
+ * zones (TINY, SMALL, LARGE) to 'fd', without allocating.
+ *
+ * The allocations are listed from a snapshot (see ft_malloc_dump()); their bytes are
+ * then copied out HEX_CHUNK_BYTES at a time under the arena locks and formatted
+ * outside them, so a multi-gigabyte dump never holds a lock for long.
  */
-void show_alloc_mem_hex(void) {
-    pthread_mutex_lock(&g_mutex);
-    printf("------ HEX DUMP OF ALLOCATED ZONES ------\n");
-    t_zone *zone = g_zones;
-    while (zone) {
-        const char *type_str = (zone->type == TINY ? "TINY" : 
-                               (zone->type == SMALL ? "SMALL" : "LARGE"));
-        printf("%s zone at %p (size %zu):\n", type_str, (void *)zone, zone->size);
-        t_block *block = zone->blocks;
-        while (block) {
-            if (!block->free) {
-                void *start = (void *)(block + 1);
-                printf("Block at %p - %zu bytes:\n", start, block->size);
-                hex_dump_block(start, block->size);
-            }
-            block = block->next;
-        }
-        zone = zone->next;
+void show_alloc_mem_hex_fd(int fd) {
+    static const char failed[] = "show_alloc_mem_hex: cannot map the snapshot buffer\n";
+    int saved_errno = errno;
+    t_snapshot snap;
+    t_out out;
+    int busy;
+
+    if (snapshot_take(&snap) != 0) {
+        write(fd, failed, sizeof(failed) - 1);
+        errno = saved_errno;
+        return;
+    }
+    out_init(&out, fd);
+    out_str(&out, "------ HEX DUMP OF ALLOCATED ZONES ------\n");
+    snapshot_report_busy(&out, &snap);
+    busy = 0;
+    for (size_t i = 0; i < snap.count; i++) {
+        if (snap.entries[i].kind == SNAPSHOT_ZONE)
+            hex_dump_zone(&out, &snap.entries[i]);
+        else if (hex_dump_allocation(&out, &snap.entries[i], busy) != 0)
+            busy = 1;
     }
-    printf("------------------------------------------\n");
-    pthread_mutex_unlock(&g_mutex);
+    out_str(&out, "------------------------------------------\n");
+    out_flush(&out);
+    snapshot_release(&snap);
+    errno = saved_errno;
+}
+
+void show_alloc_mem_hex(void) {
+    show_alloc_mem_hex_fd(STDOUT_FILENO);
 }
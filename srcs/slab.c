@@ -0,0 +1,205 @@
+#include "libft_malloc.h"
+#include <string.h>
+#include <unistd.h>
+
+// Each arena keeps per-class lists of TINY slabs that still have free slots
+// (slabs[]) and empty slabs mapped for reuse by any class (spare_slabs, chained
+// through their partial links).
+
+#define BITS_PER_WORD (sizeof(unsigned long) * 8)
+
+/**
+ * @brief Adds a slab to the partial list of its size class.
+ */
+static void partial_insert(t_zone *zone)
+{
+    t_zone **head = &zone->arena->slabs[zone->slab.obj_size / ALIGNMENT - 1];
+
+    zone->slab.prev_partial = NULL;
+    zone->slab.next_partial = *head;
+    if (*head)
+        (*head)->slab.prev_partial = zone;
+    *head = zone;
+}
+
+/**
+ * @brief Removes a slab from the partial list of its size class.
+ */
+static void partial_remove(t_zone *zone)
+{
+    if (zone->slab.prev_partial)
+        zone->slab.prev_partial->slab.next_partial = zone->slab.next_partial;
+    else
+        zone->arena->slabs[zone->slab.obj_size / ALIGNMENT - 1] = zone->slab.next_partial;
+    if (zone->slab.next_partial)
+        zone->slab.next_partial->slab.prev_partial = zone->slab.prev_partial;
+}
+
+/**
+ * @brief Lays an empty TINY zone out as a slab of 'obj_size' objects.
+ *
+ * The live bitmap sits right after the zone header and is sized for the number of
+ * objects that fit alongside it; the objects start at the next cache line, so an
+ * object never straddles more lines than its size requires.
+ *
+ * @param zone Zone with no live object.
+ * @param obj_size Size class served by the slab.
+ */
+static void slab_init(t_zone *zone, size_t obj_size)
+{
+    t_slab *slab = &zone->slab;
+    size_t avail = zone->size - sizeof(t_zone);
+    size_t words = (avail * 8 / (obj_size * 8 + 1) + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    size_t offset = (sizeof(t_zone) + words * sizeof(unsigned long) + 63) & ~(size_t)63;
+
+    zone->blocks = NULL;
+    slab->obj_size = obj_size;
+    slab->capacity = (zone->size - offset) / obj_size;
+    if (slab->capacity > words * BITS_PER_WORD)
+        slab->capacity = words * BITS_PER_WORD;
+    slab->live = 0;
+    slab->bump = 0;
+    slab->free_list = NULL;
+    slab->bitmap = (unsigned long *)(zone + 1);
+    slab->objects = (char *)zone + offset;
+    vg_defined(slab->bitmap, words * sizeof(unsigned long));
+    memset(slab->bitmap, 0, words * sizeof(unsigned long));
+}
+
+/**
+ * @brief Provides a slab for a size class that has no partial slab left.
+ *
+ * A spare empty slab is re-laid out for the class when one is available; otherwise
+ * a new TINY zone is mapped.
+ *
+ * @param arena Arena to take the slab from.
+ * @param obj_size Size class served by the slab.
+ * @return Pointer to the slab, inserted on its partial list, or NULL if mmap fails.
+ */
+static t_zone *create_slab(t_arena *arena, size_t obj_size)
+{
+    t_zone *zone = arena->spare_slabs;
+
+    if (zone)
+    {
+        arena->spare_slabs = zone->slab.next_partial;
+        arena->spare_slab_count--;
+    }
+    else
+    {
+        zone = map_zone(arena, TINY, g_config.tiny_zone_size);
+        if (!zone)
+            return NULL;
+        add_zone(zone);
+    }
+    slab_init(zone, obj_size);
+    partial_insert(zone);
+    return zone;
+}
+
+/**
+ * @brief Retires a slab whose last object was just freed.
+ *
+ * Up to g_config.retain empty slabs are kept as spares for any size class;
+ * beyond that the zone is returned to the OS.
+ *
+ * @param zone Empty slab, currently on its partial list.
+ */
+static void slab_retire(t_zone *zone)
+{
+    t_arena *arena = zone->arena;
+
+    partial_remove(zone);
+    if (arena->spare_slab_count >= g_config.retain)
+    {
+        release_zone(zone);
+        return;
+    }
+    zone->slab.next_partial = arena->spare_slabs;
+    arena->spare_slabs = zone;
+    arena->spare_slab_count++;
+}
+
+/**
+ * @brief Tells whether slot 'index' of a TINY slab holds a live object.
+ */
+int slab_is_live(t_zone *zone, size_t index)
+{
+    return (zone->slab.bitmap[index / BITS_PER_WORD] >> (index % BITS_PER_WORD)) & 1;
+}
+
+/**
+ * @brief Allocates a TINY object from a slab of its size class. Caller holds the
+ * arena lock.
+ *
+ * Recycled slots are preferred over never-used ones; a slab leaves the partial list
+ * once every slot is live.
+ *
+ * @param arena Arena to allocate from.
+ * @param aligned_size Requested size, aligned to ALIGNMENT and at most the TINY
+ *                     threshold.
+ * @return Pointer to the object, or NULL if a new slab could not be mapped.
+ */
+void *slab_alloc(t_arena *arena, size_t aligned_size)
+{
+    t_zone *zone = arena->slabs[aligned_size / ALIGNMENT - 1];
+    t_slab *slab;
+    size_t index;
+    void *obj;
+
+    if (!zone)
+        zone = create_slab(arena, aligned_size);
+    if (!zone)
+        return NULL;
+    slab = &zone->slab;
+    if (slab->free_list)
+    {
+        obj = slab->free_list;
+        slab->free_list = *(void **)obj;
+        index = ((char *)obj - slab->objects) / slab->obj_size;
+    }
+    else
+    {
+        index = slab->bump++;
+        obj = slab->objects + index * slab->obj_size;
+    }
+    slab->bitmap[index / BITS_PER_WORD] |= 1UL << (index % BITS_PER_WORD);
+    if (++slab->live == slab->capacity)
+        partial_remove(zone);
+    ARENA_STAT_ADD(arena->tiny_live, slab->obj_size);
+    return obj;
+}
+
+/**
+ * @brief Returns a TINY object to its slab. Caller holds the lock of the zone's arena.
+ *
+ * Pointers that are not the start of a live slot are ignored, which also makes a
+ * double free harmless. A slab left without live objects is retired.
+ *
+ * @param zone TINY zone owning the object.
+ * @param ptr Pointer to the object.
+ */
+void slab_free(t_zone *zone, void *ptr)
+{
+    t_slab *slab = &zone->slab;
+    size_t offset = (char *)ptr - slab->objects;
+    size_t index = offset / slab->obj_size;
+
+    if ((char *)ptr < slab->objects || offset % slab->obj_size
+        || index >= slab->bump || !slab_is_live(zone, index))
+    {
+#ifdef FT_MALLOC_HARDENED
+        harden_fail("free()", "double free of", ptr, zone, NULL);
+#endif
+        return;
+    }
+    slab->bitmap[index / BITS_PER_WORD] &= ~(1UL << (index % BITS_PER_WORD));
+    vg_defined(ptr, sizeof(void *));
+    *(void **)ptr = slab->free_list;
+    slab->free_list = ptr;
+    ARENA_STAT_ADD(zone->arena->tiny_live, -slab->obj_size);
+    if (slab->live-- == slab->capacity)
+        partial_insert(zone);
+    if (slab->live == 0)
+        slab_retire(zone);
+}
@@ -0,0 +1,243 @@
+#include "libft_malloc.h"
+#include <string.h>
+#include <sys/mman.h>
+
+// Entries the first snapshot buffer holds; later ones start from the last count.
+#define SNAPSHOT_MIN_ENTRIES    4096
+
+static size_t g_snapshot_hint = SNAPSHOT_MIN_ENTRIES;
+
+/**
+ * @brief Records one entry if the buffer has room for it; counts it either way, so
+ * a walk over a full buffer still measures how much room it needs.
+ */
+static void snapshot_add(t_snapshot *snap, t_zone *zone, int kind, const void *addr,
+                         size_t size)
+{
+    t_snapshot_entry *entry;
+
+    if (snap->count < snap->capacity)
+    {
+        entry = &snap->entries[snap->count];
+        entry->addr = (uintptr_t)addr;
+        entry->size = size;
+        entry->zone = zone;
+        entry->kind = kind;
+        entry->type = zone->type;
+    }
+    snap->count++;
+}
+
+/**
+ * @brief Records a zone followed by its live allocations. Caller holds the arena lock.
+ *
+ * Allocations tagged as freed sit in a thread cache or in quarantine: the zone still
+ * counts them as live, the program does not, so they are left out.
+ */
+static void snapshot_zone(t_snapshot *snap, t_zone *zone)
+{
+    t_slab *slab = &zone->slab;
+    char *obj;
+
+    snapshot_add(snap, zone, SNAPSHOT_ZONE, zone, zone->size);
+    if (zone->type == TINY)
+    {
+        for (size_t i = 0; i < slab->bump; i++)
+        {
+            obj = slab->objects + i * slab->obj_size;
+            if (slab_is_live(zone, i) && !vg_freed_tagged(obj))
+                snapshot_add(snap, zone, SNAPSHOT_ALLOC, obj, slab->obj_size);
+        }
+        return;
+    }
+    for (t_block *block = zone->blocks; block; block = BLOCK_NEXT(block))
+    {
+        if (!BLOCK_IS_FREE(block) && (zone->type == LARGE || !vg_freed_tagged(block + 1)))
+            snapshot_add(snap, zone, SNAPSHOT_ALLOC, block + 1, BLOCK_PAYLOAD(block));
+    }
+}
+
+static int entry_before(const t_snapshot_entry *a, const t_snapshot_entry *b)
+{
+    if (a->type != b->type)
+        return a->type < b->type;
+    return a->addr < b->addr;
+}
+
+static void sift_down(t_snapshot_entry *entries, size_t root, size_t count)
+{
+    t_snapshot_entry tmp;
+    size_t child;
+
+    while ((child = 2 * root + 1) < count)
+    {
+        if (child + 1 < count && entry_before(&entries[child], &entries[child + 1]))
+            child++;
+        if (!entry_before(&entries[root], &entries[child]))
+            return;
+        tmp = entries[root];
+        entries[root] = entries[child];
+        entries[child] = tmp;
+        root = child;
+    }
+}
+
+/**
+ * @brief Sorts the entries by zone type, then address, in place: heapsort needs no
+ * memory and no recursion, unlike qsort(), which may allocate.
+ */
+static void snapshot_sort(t_snapshot *snap)
+{
+    t_snapshot_entry *entries = snap->entries;
+    t_snapshot_entry tmp;
+
+    for (size_t i = snap->count / 2; i-- > 0;)
+        sift_down(entries, i, snap->count);
+    for (size_t end = snap->count; end-- > 1;)
+    {
+        tmp = entries[0];
+        entries[0] = entries[end];
+        entries[end] = tmp;
+        sift_down(entries, 0, end);
+    }
+}
+
+/**
+ * @brief Maps a buffer of 'capacity' entries for a snapshot.
+ *
+ * @return 0 on success, -1 if mmap fails.
+ */
+static int snapshot_reserve(t_snapshot *snap, size_t capacity)
+{
+    size_t bytes = capacity * sizeof(t_snapshot_entry);
+    void *entries = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (entries == MAP_FAILED)
+        return -1;
+    snapshot_release(snap);
+    snap->entries = entries;
+    snap->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Copies the metadata of every zone and live allocation, sorted by zone type
+ * then address, into a buffer mapped for the occasion.
+ *
+ * The arenas are locked together only while their zones are walked and the entries
+ * copied; nothing is formatted nor allocated under the locks. When the walk finds
+ * more entries than the buffer holds, the locks are dropped, a buffer sized after
+ * the count is mapped and the walk starts over. Arenas that cannot be locked (see
+ * arena_lock_all()) are left out and flagged in snap->arenas.
+ *
+ * @param snap Snapshot to fill; release it with snapshot_release().
+ * @return 0 on success, -1 if no buffer could be mapped.
+ */
+int snapshot_take(t_snapshot *snap)
+{
+    size_t capacity = __atomic_load_n(&g_snapshot_hint, __ATOMIC_RELAXED);
+
+    memset(snap, 0, sizeof(*snap));
+    for (;;)
+    {
+        if (snapshot_reserve(snap, capacity) != 0)
+            return -1;
+        snap->count = 0;
+        snap->arenas = arena_lock_all(1);
+        for (size_t i = 0; i < arena_count(); i++)
+        {
+            if (!(snap->arenas & (1ULL << i)))
+                continue;
+            for (t_zone *zone = g_arenas[i].zones; zone; zone = zone->next)
+                snapshot_zone(snap, zone);
+        }
+        arena_unlock_all(snap->arenas);
+        if (snap->count <= snap->capacity)
+            break;
+        capacity = snap->count + snap->count / 4;
+    }
+    __atomic_store_n(&g_snapshot_hint, capacity, __ATOMIC_RELAXED);
+    snapshot_sort(snap);
+    return 0;
+}
+
+void snapshot_release(t_snapshot *snap)
+{
+    if (snap->entries)
+        munmap(snap->entries, snap->capacity * sizeof(t_snapshot_entry));
+    snap->entries = NULL;
+    snap->capacity = 0;
+}
+
+/**
+ * @brief Tells whether the allocation of a snapshot entry still exists, and is not
+ * parked in a thread cache, with at least 'end' bytes. Caller holds every arena lock.
+ */
+static int entry_live(const t_snapshot_entry *entry, size_t end)
+{
+    t_zone *zone = entry->zone;
+    char *ptr = (char *)entry->addr;
+    t_block *block = (t_block *)ptr - 1;
+    size_t offset;
+
+    if (pagemap_lookup(ptr) != zone)
+        return 0;
+    if (zone->type == TINY)
+    {
+        offset = ptr - zone->slab.objects;
+        return zone->slab.obj_size == entry->size && ptr >= zone->slab.objects
+               && offset % entry->size == 0 && offset / entry->size < zone->slab.bump
+               && slab_is_live(zone, offset / entry->size) && !vg_freed_tagged(ptr);
+    }
+    if (zone->type == LARGE && block != zone->blocks)
+        return 0;
+    return (char *)block >= (char *)zone->blocks && !BLOCK_IS_FREE(block)
+           && BLOCK_PAYLOAD(block) >= end && ptr + end <= (char *)zone + zone->size
+           && (zone->type == LARGE || !vg_freed_tagged(ptr));
+}
+
+/**
+ * @brief Copies 'len' bytes at 'offset' into the allocation of a snapshot entry,
+ * if it was not freed since the snapshot.
+ *
+ * Every arena is locked for the copy alone, so a large allocation is read in short
+ * critical sections and allocating threads are only held up for one of them. The
+ * copy is defined to Valgrind, whatever the program left in the allocation.
+ *
+ * @return 0 if the bytes were copied, -1 if the allocation is gone or shrank, -2 if
+ *         an arena lock could not be taken.
+ */
+int snapshot_read(const t_snapshot_entry *entry, size_t offset, void *buf, size_t len)
+{
+    size_t count = arena_count();
+    uint64_t all = count == 64 ? ~0ULL : (1ULL << count) - 1;
+    uint64_t locked;
+    int ret = -2;
+
+    locked = arena_lock_all(0);
+    if (locked == all)
+        ret = entry_live(entry, offset + len) ? 0 : -1;
+    if (ret == 0)
+    {
+        memcpy(buf, (char *)entry->addr + offset, len);
+        vg_defined(buf, len);
+    }
+    arena_unlock_all(locked);
+    return ret;
+}
+
+/**
+ * @brief Writes a line for every arena the snapshot had to leave out.
+ */
+void snapshot_report_busy(t_out *out, const t_snapshot *snap)
+{
+    for (size_t i = 0; i < arena_count(); i++)
+    {
+        if (snap->arenas & (1ULL << i))
+            continue;
+        out_str(out, "arena ");
+        out_dec(out, i);
+        out_str(out, " busy, skipped\n");
+    }
+}
@@ -0,0 +1,178 @@
+#include "libft_malloc.h"
+#include <malloc.h>
+#include <string.h>
+#include <pthread.h>
+
+__thread t_thread_stats g_thread_stats __attribute__((tls_model("initial-exec")));
+
+static pthread_mutex_t g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_stats_key;
+static int g_stats_keyed;
+static t_thread_stats *g_stats_threads;
+// Counts of the threads that exited, and of events counted while not on the list.
+static size_t g_stats_retired[STAT_COUNTERS];
+
+/**
+ * @brief Thread exit destructor: folds the thread's counts into the retired ones and
+ * takes it off the list.
+ *
+ * @param arg The exiting thread's counters (unused, the TLS copy is still reachable).
+ */
+static void stats_detach(void *arg)
+{
+    t_thread_stats *ts = &g_thread_stats;
+
+    (void)arg;
+    pthread_mutex_lock(&g_stats_lock);
+    for (size_t i = 0; i < STAT_COUNTERS; i++)
+        __atomic_fetch_add(&g_stats_retired[i], ts->counts[i], __ATOMIC_RELAXED);
+    if (ts->prev)
+        ts->prev->next = ts->next;
+    else
+        g_stats_threads = ts->next;
+    if (ts->next)
+        ts->next->prev = ts->prev;
+    ts->state = STATS_DETACHED;
+    pthread_mutex_unlock(&g_stats_lock);
+}
+
+static void stats_global_init(void)
+{
+    g_stats_keyed = pthread_key_create(&g_stats_key, stats_detach) == 0;
+}
+
+/**
+ * @brief Slow path of stats_count(): puts the calling thread on the list on its first
+ * event, and counts events of threads that cannot be on it in the retired counts.
+ *
+ * The thread is marked busy while it registers, so an allocation made by
+ * pthread_setspecific() is counted without recursing.
+ *
+ * @param counter Counter to increment (enum e_stat_counter).
+ */
+void stats_attach(size_t counter)
+{
+    t_thread_stats *ts = &g_thread_stats;
+
+    if (ts->state == STATS_UNINIT)
+    {
+        ts->state = STATS_BUSY;
+        pthread_once(&g_stats_once, stats_global_init);
+        if (g_stats_keyed && pthread_setspecific(g_stats_key, ts) == 0)
+        {
+            pthread_mutex_lock(&g_stats_lock);
+            ts->prev = NULL;
+            ts->next = g_stats_threads;
+            if (g_stats_threads)
+                g_stats_threads->prev = ts;
+            g_stats_threads = ts;
+            ts->state = STATS_ACTIVE;
+            pthread_mutex_unlock(&g_stats_lock);
+        }
+        else
+            ts->state = STATS_DETACHED;
+    }
+    if (ts->state == STATS_ACTIVE)
+        __atomic_store_n(&ts->counts[counter], ts->counts[counter] + 1, __ATOMIC_RELAXED);
+    else
+        __atomic_fetch_add(&g_stats_retired[counter], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Fork handler of the thread list lock (see fork_mutex()). Threads that do not
+ * survive in a child stay on its list, their counts included.
+ */
+void stats_fork(int phase)
+{
+    fork_mutex(&g_stats_lock, phase);
+}
+
+/**
+ * @brief Sums the event counters of every thread, live or exited.
+ *
+ * Only the list lock is taken, for as long as it takes to read one line of counters
+ * per live thread; allocations never wait for it.
+ */
+static void stats_sum(size_t *counts)
+{
+    pthread_mutex_lock(&g_stats_lock);
+    for (size_t i = 0; i < STAT_COUNTERS; i++)
+        counts[i] = __atomic_load_n(&g_stats_retired[i], __ATOMIC_RELAXED);
+    for (t_thread_stats *ts = g_stats_threads; ts; ts = ts->next)
+    {
+        for (size_t i = 0; i < STAT_COUNTERS; i++)
+            counts[i] += __atomic_load_n(&ts->counts[i], __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&g_stats_lock);
+}
+
+/**
+ * @brief Returns a snapshot of the allocator footprint and activity.
+ *
+ * Arena counters are read without their locks, so while other threads allocate the
+ * figures of different arenas may be a few operations apart; each of them is exact
+ * once the process is quiet.
+ *
+ * @return Mapped, used and free bytes, zone counts and event counts by zone type,
+ *         and their totals.
+ */
+t_malloc_stats ft_malloc_stats(void)
+{
+    t_malloc_stats stats;
+    size_t counts[STAT_COUNTERS];
+    size_t tiny_live = 0;
+    size_t small_free = 0;
+    t_malloc_type_stats *type;
+    t_arena *arena;
+
+    memset(&stats, 0, sizeof(stats));
+    for (size_t i = 0; i < arena_count(); i++)
+    {
+        arena = &g_arenas[i];
+        for (int t = 0; t < ZONE_TYPES; t++)
+        {
+            stats.types[t].zones += __atomic_load_n(&arena->zone_count[t], __ATOMIC_RELAXED);
+            stats.types[t].mapped += __atomic_load_n(&arena->mapped[t], __ATOMIC_RELAXED);
+        }
+        tiny_live += __atomic_load_n(&arena->tiny_live, __ATOMIC_RELAXED);
+        small_free += __atomic_load_n(&arena->small_free, __ATOMIC_RELAXED);
+    }
+    stats.types[TINY].in_use = tiny_live;
+    stats.types[SMALL].in_use = stats.types[SMALL].mapped - small_free;
+    stats.types[LARGE].in_use = stats.types[LARGE].mapped;
+    stats_sum(counts);
+    for (int t = 0; t < ZONE_TYPES; t++)
+    {
+        type = &stats.types[t];
+        // Counters of different arenas are not read at the same instant.
+        if (type->in_use > type->mapped)
+            type->in_use = type->mapped;
+        type->free = type->mapped - type->in_use;
+        type->allocs = counts[STAT_ALLOCS + t];
+        type->frees = counts[STAT_FREES + t];
+        stats.mapped += type->mapped;
+        stats.in_use += type->in_use;
+        stats.free += type->free;
+    }
+    stats.reallocs = counts[STAT_REALLOCS];
+    return stats;
+}
+
+/**
+ * @brief glibc-compatible view of ft_malloc_stats(): TINY and SMALL zones play the
+ * part of the main arena, LARGE zones that of the mmapped chunks.
+ */
+struct mallinfo2 mallinfo2(void)
+{
+    t_malloc_stats stats = ft_malloc_stats();
+    struct mallinfo2 info;
+
+    memset(&info, 0, sizeof(info));
+    info.arena = stats.types[TINY].mapped + stats.types[SMALL].mapped;
+    info.hblks = stats.types[LARGE].zones;
+    info.hblkhd = stats.types[LARGE].mapped;
+    info.uordblks = stats.types[TINY].in_use + stats.types[SMALL].in_use;
+    info.fordblks = stats.types[TINY].free + stats.types[SMALL].free;
+    return info;
+}
@@ -0,0 +1,237 @@
+#include "libft_malloc.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+enum e_tcache_state {
+    TCACHE_UNINIT,
+    TCACHE_ACTIVE,
+    TCACHE_BYPASS
+};
+
+/**
+ * @brief Per-thread cache of TINY and SMALL allocations.
+ *
+ * Bin i (see TCACHE_BIN()) holds user pointers of at least
+ * (i + 1) * ALIGNMENT - BLOCK_OVERHEAD usable bytes, chained through their first
+ * word and tagged as freed in their second (see FREED_TAG()). Cached allocations
+ * stay live in their zone, so nothing else touches them while they sit in the cache.
+ */
+typedef struct s_tcache {
+    void            *bins[TCACHE_BINS];
+    unsigned short  counts[TCACHE_BINS];
+    int             state;
+} t_tcache;
+
+static __thread t_tcache g_tcache __attribute__((tls_model("initial-exec")));
+static pthread_once_t g_tcache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_tcache_key;
+static int g_tcache_enabled;
+
+/**
+ * @brief Returns up to 'count' entries of a bin to their zones.
+ *
+ * Entries of the thread's own arena are released under a single lock round trip.
+ * Entries of other arenas are never released under their lock: consecutive ones
+ * of the same arena are chained and pushed onto its remote-free stack at once.
+ *
+ * @param tc Thread cache to flush.
+ * @param bin Index of the bin to flush.
+ * @param count Maximum number of entries to release.
+ */
+static void tcache_flush(t_tcache *tc, size_t bin, unsigned int count)
+{
+    t_arena *own = arena_get();
+    t_arena *remote = NULL;
+    void *first = NULL;
+    void *last = NULL;
+    int locked = 0;
+    void *ptr;
+    t_zone *zone;
+
+    while (count-- && tc->bins[bin])
+    {
+        ptr = tc->bins[bin];
+        tc->bins[bin] = *(void **)ptr;
+        tc->counts[bin]--;
+        FREED_TAG(ptr) = 0;
+        zone = get_zone_for_ptr(ptr);
+        if (!zone)
+            continue;
+        if (zone->arena == own)
+        {
+            if (!locked)
+            {
+                pthread_mutex_lock(&own->mutex);
+                arena_drain(own);
+            }
+            locked = 1;
+            release_ptr(zone, ptr);
+            continue;
+        }
+        if (zone->arena != remote && first)
+        {
+            arena_remote_free(remote, first, last);
+            first = NULL;
+        }
+        remote = zone->arena;
+        *(void **)ptr = first;
+        if (!first)
+            last = ptr;
+        first = ptr;
+    }
+    if (first)
+        arena_remote_free(remote, first, last);
+    if (locked)
+        pthread_mutex_unlock(&own->mutex);
+}
+
+/**
+ * @brief Thread exit destructor: hands every cached allocation back to the zones.
+ *
+ * @param arg The exiting thread's cache (unused, the TLS copy is still reachable).
+ */
+static void tcache_destroy(void *arg)
+{
+    (void)arg;
+    for (size_t bin = 0; bin < TCACHE_BINS; bin++)
+    {
+        if (g_tcache.bins[bin])
+            tcache_flush(&g_tcache, bin, g_tcache.counts[bin]);
+    }
+    g_tcache.state = TCACHE_BYPASS;
+}
+
+/**
+ * @brief One-time setup: registers the thread exit destructor unless the caches
+ * are disabled (FT_MALLOC_TCACHE=0).
+ */
+static void tcache_global_init(void)
+{
+    config_init();
+    g_tcache_enabled = g_config.tcache != 0;
+    if (g_tcache_enabled && pthread_key_create(&g_tcache_key, tcache_destroy) != 0)
+        g_tcache_enabled = 0;
+}
+
+/**
+ * @brief Returns the calling thread's cache, initializing it on first use.
+ *
+ * The cache is switched to bypass while it registers itself, so any allocation made
+ * by pthread_setspecific() falls through to the locked path instead of recursing.
+ *
+ * @return Pointer to the thread cache, or NULL if the cache must not be used.
+ */
+static t_tcache *tcache_get(void)
+{
+    t_tcache *tc = &g_tcache;
+
+    if (tc->state == TCACHE_ACTIVE)
+        return tc;
+    if (tc->state != TCACHE_UNINIT)
+        return NULL;
+    tc->state = TCACHE_BYPASS;
+    pthread_once(&g_tcache_once, tcache_global_init);
+    if (!g_tcache_enabled || pthread_setspecific(g_tcache_key, tc) != 0)
+        return NULL;
+    tc->state = TCACHE_ACTIVE;
+    return tc;
+}
+
+/**
+ * @brief Fills an empty bin with half a bin's worth of allocations from the thread's
+ * arena under a single lock.
+ *
+ * @return Non-zero if at least one allocation was added to the bin.
+ */
+static int tcache_refill(t_tcache *tc, size_t bin, size_t aligned_size)
+{
+    t_arena *arena = arena_lock();
+    void *ptr;
+
+    for (unsigned int i = 0; i < (g_config.tcache + 1) / 2; i++)
+    {
+        ptr = alloc_ptr(arena, aligned_size);
+        if (!ptr)
+            break;
+        vg_defined(ptr, 2 * sizeof(void *));
+        *(void **)ptr = tc->bins[bin];
+        FREED_TAG(ptr) = g_config.canary;
+        tc->bins[bin] = ptr;
+        tc->counts[bin]++;
+    }
+    pthread_mutex_unlock(&arena->mutex);
+    return tc->bins[bin] != NULL;
+}
+
+/**
+ * @brief Serves a TINY or SMALL allocation from the calling thread's cache.
+ *
+ * @param aligned_size Requested size, from REQUEST_SIZE().
+ * @return Pointer to the user memory, or NULL if the request must take the locked path.
+ */
+void *tcache_malloc(size_t aligned_size)
+{
+    t_tcache *tc;
+    void *ptr;
+    size_t bin;
+
+    if (aligned_size > SMALL_PAYLOAD_MAX)
+        return NULL;
+    tc = tcache_get();
+    if (!tc)
+        return NULL;
+    bin = TCACHE_BIN(aligned_size);
+    if (!tc->bins[bin] && !tcache_refill(tc, bin, aligned_size))
+        return NULL;
+    ptr = tc->bins[bin];
+    tc->bins[bin] = *(void **)ptr;
+    tc->counts[bin]--;
+    FREED_TAG(ptr) = 0;
+    return ptr;
+}
+
+/**
+ * @brief Parks a freed TINY or SMALL allocation in the calling thread's cache.
+ *
+ * The owning zone is found through the lock-free page map, so allocations made by
+ * other threads are accepted too; when a bin grows past g_config.tcache entries,
+ * half of it is flushed back to the zones in one batch.
+ *
+ * @param ptr Pointer to the user memory being freed.
+ * @return Non-zero if the allocation was cached, 0 if free() must take the locked path.
+ */
+int tcache_free(void *ptr)
+{
+    t_tcache *tc;
+    t_block *block;
+    t_zone *zone;
+    size_t size;
+    size_t bin;
+
+    tc = tcache_get();
+    if (!tc)
+        return 0;
+    zone = get_zone_for_ptr(ptr);
+    if (!zone || zone->type == LARGE)
+        return 0;
+    if (zone->type == TINY)
+        size = zone->slab.obj_size;
+    else
+    {
+        block = (t_block *)ptr - 1;
+        size = BLOCK_PAYLOAD(block);
+        if (BLOCK_IS_FREE(block) || size > SMALL_PAYLOAD_MAX)
+            return 0;
+    }
+    stats_count(STAT_FREES + zone->type);
+    if (__builtin_expect(zone->prof_samples != 0, 0))
+        prof_forget(zone, ptr);
+    bin = TCACHE_BIN(size);
+    vg_defined(ptr, 2 * sizeof(void *));
+    *(void **)ptr = tc->bins[bin];
+    FREED_TAG(ptr) = g_config.canary;
+    tc->bins[bin] = ptr;
+    if (++tc->counts[bin] > g_config.tcache)
+        tcache_flush(tc, bin, (g_config.tcache + 1) / 2);
+    return 1;
+}
@@ -0,0 +1,138 @@
+#include "libft_malloc.h"
+#include <valgrind/memcheck.h>
+
+/**
+ * @brief Creates the meta mempool of every arena. Runs once, before the first zone
+ * is mapped.
+ */
+void vg_init(void)
+{
+    for (size_t i = 0; i < ARENA_MAX; i++)
+        VALGRIND_CREATE_MEMPOOL_EXT(&g_arenas[i], 0, 0,
+                                    VALGRIND_MEMPOOL_METAPOOL | VALGRIND_MEMPOOL_AUTO_FREE);
+}
+
+/**
+ * @brief Marks allocator metadata held in zone memory (block headers, boundary tags,
+ * free links, slab bitmaps) addressable and defined before it is read or written.
+ *
+ * The marks stay: a header is never part of a payload handed out, and the two link
+ * words of a free allocation are marked undefined again when it is reallocated.
+ */
+void vg_defined(const void *addr, size_t size)
+{
+    VALGRIND_MAKE_MEM_DEFINED(addr, size);
+}
+
+/**
+ * @brief Marks memory the program must not touch NOACCESS again, such as the
+ * poisoned bytes of a quarantined allocation.
+ */
+void vg_noaccess(const void *addr, size_t size)
+{
+    VALGRIND_MAKE_MEM_NOACCESS(addr, size);
+}
+
+/**
+ * @brief FREED_TAGGED() for an allocation that may be live, whose second word is
+ * then the program's and possibly undefined: the word is read as defined and its
+ * state restored afterwards, so neither side sees an error.
+ */
+int vg_freed_tagged(void *ptr)
+{
+    uintptr_t vbits;
+    int tagged;
+
+    if (VALGRIND_GET_VBITS(&FREED_TAG(ptr), &vbits, sizeof(vbits)) != 1)
+        return FREED_TAGGED(ptr);
+    VALGRIND_MAKE_MEM_DEFINED(&FREED_TAG(ptr), sizeof(uintptr_t));
+    tagged = FREED_TAGGED(ptr);
+    VALGRIND_SET_VBITS(&FREED_TAG(ptr), &vbits, sizeof(vbits));
+    return tagged;
+}
+
+/**
+ * @brief Hands an allocation to the program: its usable size becomes addressable,
+ * undefined unless 'zeroed', and tracked for leaks from here on.
+ */
+void vg_alloc(void *ptr, int zeroed)
+{
+    if (ptr)
+        VALGRIND_MALLOCLIKE_BLOCK(ptr, alloc_size(get_zone_for_ptr(ptr), ptr), 0, zeroed);
+}
+
+/**
+ * @brief Takes an allocation back once free() or realloc() has found it to be one,
+ * before it is released; it is NOACCESS from here on.
+ */
+void vg_free(void *ptr)
+{
+    VALGRIND_FREELIKE_BLOCK(ptr, 0);
+}
+
+/**
+ * @brief Records an allocation resized without copying, 'old_size' being its usable
+ * size before.
+ *
+ * A SMALL block shrunk in place left a successor in the bytes it gave back, whose
+ * header, free links and boundary tag are marked defined again. A LARGE allocation moved by
+ * mremap() is a new block to Valgrind; the bytes it kept are marked defined, since
+ * the remap already moved their state.
+ */
+void vg_resize(void *old_ptr, void *ptr, size_t old_size)
+{
+    t_zone *zone = get_zone_for_ptr(ptr);
+    size_t size = alloc_size(zone, ptr);
+    t_block *next;
+
+    if (ptr == old_ptr)
+    {
+        VALGRIND_RESIZEINPLACE_BLOCK(ptr, old_size, size, 0);
+        next = zone->type == SMALL && size < old_size ? BLOCK_NEXT((t_block *)ptr - 1) : NULL;
+        if (!next)
+            return;
+        VALGRIND_MAKE_MEM_DEFINED(&next->head, sizeof(next->head));
+        if (!BLOCK_IS_FREE(next))
+            return;
+        VALGRIND_MAKE_MEM_DEFINED(FREE_LINKS(next), sizeof(t_free_links));
+        if (BLOCK_NEXT(next))
+            VALGRIND_MAKE_MEM_DEFINED(&BLOCK_NEXT(next)->prev_size, sizeof(size_t));
+        return;
+    }
+    VALGRIND_FREELIKE_BLOCK(old_ptr, 0);
+    VALGRIND_MALLOCLIKE_BLOCK(ptr, size, 0, 0);
+    VALGRIND_MAKE_MEM_DEFINED(ptr, old_size < size ? old_size : size);
+}
+
+/**
+ * @brief Registers a freshly mapped zone as a superblock of its arena's mempool,
+ * NOACCESS past its header until allocations or metadata are placed in it.
+ */
+void vg_zone_map(t_zone *zone)
+{
+    VALGRIND_MEMPOOL_ALLOC(zone->arena, zone, zone->size);
+    VALGRIND_MAKE_MEM_NOACCESS((char *)zone + ZONE_HEADER_SIZE, zone->size - ZONE_HEADER_SIZE);
+}
+
+/**
+ * @brief Records a LARGE zone resized or moved by mremap(); pages it gained are
+ * NOACCESS like the rest of the zone.
+ *
+ * @param old_zone Address of the zone before the move ('zone' if it stayed).
+ * @param zone The zone, with its new size.
+ * @param old_size Size of the zone before.
+ */
+void vg_zone_move(void *old_zone, t_zone *zone, size_t old_size)
+{
+    VALGRIND_MEMPOOL_CHANGE(zone->arena, old_zone, zone, zone->size);
+    if (zone->size > old_size)
+        VALGRIND_MAKE_MEM_NOACCESS((char *)zone + old_size, zone->size - old_size);
+}
+
+/**
+ * @brief Drops a zone about to be unmapped from its arena's mempool.
+ */
+void vg_zone_unmap(t_zone *zone)
+{
+    VALGRIND_MEMPOOL_FREE(zone->arena, zone);
+}
@@ -3,6 +3,11 @@
 #include <string.h>
 #include <assert.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
 #include "libft_malloc.h"
 
 void    *malloc(size_t size);
@@ -110,6 +115,93 @@ void test_free_many_blocks(void)
     printf("test_free_many_blocks passed.\n");
 }
 
+//-----------------------------------------------------------------------------
+// Test 5b: Pointers that no zone owns are ignored, while many LARGE zones
+// are mapped and unmapped around them (hardened builds abort on them instead,
+// see test_hardened_free).
+//-----------------------------------------------------------------------------
+void test_free_unknown_pointer(void)
+{
+    printf("Running test_free_unknown_pointer...\n");
+    #define NUM_LARGE 256
+    static char not_ours[256];
+    char *large[NUM_LARGE];
+
+    for (int i = 0; i < NUM_LARGE; i++) {
+        large[i] = malloc(4096 + i);
+        assert(large[i] != NULL);
+        memset(large[i], 'L', 4096 + i);
+    }
+#ifndef FT_MALLOC_HARDENED
+    free(not_ours + 64);
+#endif
+    for (int i = 0; i < NUM_LARGE; i += 2)
+        free(large[i]);
+#ifndef FT_MALLOC_HARDENED
+    free(not_ours + 128);
+#endif
+    for (int i = 1; i < NUM_LARGE; i += 2) {
+        assert(large[i][0] == 'L' && large[i][4095 + i] == 'L');
+        free(large[i]);
+    }
+    #undef NUM_LARGE
+    printf("test_free_unknown_pointer passed.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Test 5c: Zones emptied by a burst are returned to the OS.
+// Resident set size is read from /proc/self/statm before, during and after a
+// burst of TINY and SMALL allocations; once everything is freed, RSS must fall
+// back close to where it started (only FT_MALLOC_RETAIN spare zones remain).
+//-----------------------------------------------------------------------------
+static long resident_kb(void)
+{
+    char buf[128];
+    long size = 0;
+    long resident = 0;
+    int fd = open("/proc/self/statm", O_RDONLY);
+
+    if (fd < 0)
+        return -1;
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return -1;
+    buf[len] = '\0';
+    if (sscanf(buf, "%ld %ld", &size, &resident) != 2)
+        return -1;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void test_free_returns_memory(void)
+{
+    printf("Running test_free_returns_memory...\n");
+    #define BURST 20000
+    static char *tiny[BURST];
+    static char *small[BURST];
+
+    long before = resident_kb();
+    for (int i = 0; i < BURST; i++) {
+        tiny[i] = malloc(48);
+        small[i] = malloc(512);
+        assert(tiny[i] && small[i]);
+        memset(tiny[i], 'T', 48);
+        memset(small[i], 'S', 512);
+    }
+    long peak = resident_kb();
+    for (int i = 0; i < BURST; i++) {
+        free(tiny[i]);
+        free(small[i]);
+    }
+    long after = resident_kb();
+    printf("RSS before burst: %ld KiB, peak: %ld KiB, after free: %ld KiB\n",
+           before, peak, after);
+    if (before >= 0)
+        assert(after - before < (peak - before) / 4);
+    #undef BURST
+    printf("test_free_returns_memory passed.\n");
+}
+
 //-----------------------------------------------------------------------------
 // Test 6: Stress test: Mixed allocations and frees in a loop.
 //-----------------------------------------------------------------------------
@@ -129,6 +221,147 @@ void test_free_stress(void)
     printf("test_free_stress passed.\n");
 }
 
+//-----------------------------------------------------------------------------
+// Test 7: Hardened builds abort with a diagnostic on double and invalid frees,
+// overflows into the next block header, writes after free in quarantine and
+// overflows into the guard page of a LARGE zone. A second free() from another
+// thread is caught as well. Each misuse runs in a child;
+// writes after free need a quarantine (FT_MALLOC_CONF=quarantine:<bytes>).
+//-----------------------------------------------------------------------------
+#ifdef FT_MALLOC_HARDENED
+enum e_misuse {
+    MISUSE_DOUBLE_FREE_TINY,
+    MISUSE_DOUBLE_FREE_SMALL,
+    MISUSE_DOUBLE_FREE_LARGE,
+    MISUSE_INVALID_FREE,
+    MISUSE_INTERIOR_FREE,
+    MISUSE_OVERFLOW,
+    MISUSE_WRITE_AFTER_FREE,
+    MISUSE_CROSS_THREAD_TINY,
+    MISUSE_CROSS_THREAD_SMALL,
+    MISUSE_GUARD_PAGE,
+    MISUSES
+};
+
+// Frees the pointer read from the pipe 'arg' a second time. The thread is started
+// before the first free(), so that its own setup cannot reuse the allocation.
+static void *free_again(void *arg)
+{
+    char *ptr;
+
+    assert(read(*(int *)arg, &ptr, sizeof(ptr)) == sizeof(ptr));
+    free(ptr);
+    return malloc(16);
+}
+
+static void misuse(int kind)
+{
+    static char not_ours[64];
+    char *ptr;
+    char *next;
+
+    switch (kind) {
+    case MISUSE_DOUBLE_FREE_TINY:
+        ptr = malloc(24);
+        free(ptr);
+        free(ptr);
+        break;
+    case MISUSE_DOUBLE_FREE_SMALL:
+        ptr = malloc(300);
+        free(ptr);
+        free(ptr);
+        break;
+    case MISUSE_DOUBLE_FREE_LARGE:
+        ptr = malloc(100000);
+        free(ptr);
+        free(ptr);
+        break;
+    case MISUSE_INVALID_FREE:
+        free(not_ours + 16);
+        break;
+    case MISUSE_INTERIOR_FREE:
+        ptr = malloc(300);
+        free(ptr + 32);
+        break;
+    case MISUSE_OVERFLOW:
+        ptr = malloc(300);
+        next = malloc(300);
+        memset(ptr, 'O', malloc_usable_size(ptr) + 16);
+        free(ptr);
+        free(next);
+        break;
+    case MISUSE_WRITE_AFTER_FREE:
+        ptr = malloc(300);
+        free(ptr);
+        ptr[100] = 'W';
+        for (int i = 0; i < 64; i++)
+            free(malloc(300));
+        break;
+    case MISUSE_CROSS_THREAD_TINY:
+    case MISUSE_CROSS_THREAD_SMALL: {
+        pthread_t thread;
+        int fds[2];
+
+        assert(pipe(fds) == 0);
+        assert(pthread_create(&thread, NULL, free_again, &fds[0]) == 0);
+        ptr = malloc(kind == MISUSE_CROSS_THREAD_TINY ? 16 : 600);
+        free(ptr);
+        assert(write(fds[1], &ptr, sizeof(ptr)) == sizeof(ptr));
+        pthread_join(thread, NULL);
+        break;
+    }
+    case MISUSE_GUARD_PAGE:
+        ptr = malloc(100000);
+        // The guard page starts at the first page boundary past the payload.
+        *(char *)(((uintptr_t)ptr + malloc_usable_size(ptr) + 4095) & ~4095UL) = 'G';
+        break;
+    }
+}
+
+void test_hardened_free(void)
+{
+    printf("Running test_hardened_free...\n");
+    static const char *const expected[MISUSES] = {
+        "free(): double free of", "free(): double free of", "free(): invalid pointer",
+        "free(): invalid pointer", "free(): invalid pointer or corrupted block header",
+        "free(): heap overflow past", "free(): write after free to",
+        "free(): double free of", "free(): double free of", NULL
+    };
+    char report[512];
+    ssize_t len;
+    int fds[2];
+    int status;
+    pid_t pid;
+
+    for (int kind = 0; kind < MISUSES; kind++) {
+        // Writes after free are only caught in quarantine.
+        if (kind == MISUSE_WRITE_AFTER_FREE && g_config.quarantine < 300)
+            continue;
+        assert(pipe(fds) == 0);
+        pid = fork();
+        assert(pid >= 0);
+        if (pid == 0) {
+            dup2(fds[1], STDERR_FILENO);
+            misuse(kind);
+            _exit(0);
+        }
+        close(fds[1]);
+        len = read(fds[0], report, sizeof(report) - 1);
+        report[len > 0 ? len : 0] = '\0';
+        close(fds[0]);
+        assert(waitpid(pid, &status, 0) == pid);
+        if (expected[kind]) {
+            assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+            assert(strstr(report, expected[kind]) != NULL);
+            assert(strstr(report, "called from") != NULL || kind == MISUSE_WRITE_AFTER_FREE);
+        }
+        else
+            assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+    }
+    printf("test_hardened_free passed.\n");
+}
+#endif
+
 //-----------------------------------------------------------------------------
 // Main: Run All Tests
 //-----------------------------------------------------------------------------
@@ -139,7 +372,12 @@ int main(void)
     test_coalesce_adjacent_blocks();
     // test_double_free();
     test_free_many_blocks();
+    test_free_unknown_pointer();
+    test_free_returns_memory();
     test_free_stress();
+#ifdef FT_MALLOC_HARDENED
+    test_hardened_free();
+#endif
     printf("All free tests passed successfully.\n");
     return 0;
 }
@@ -3,6 +3,11 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <errno.h>
+#include <malloc.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "libft_malloc.h"
 
 void    *malloc(size_t size);
@@ -48,6 +53,36 @@ void test_malloc_tiny_boundary(void)
     printf("test_malloc_tiny_boundary passed.\n");
 }
 
+//-----------------------------------------------------------------------------
+// Test 3b: TINY objects carry no per-object header, so a run of 16-byte
+// allocations packs into well under the 48 bytes per object a header would cost.
+//-----------------------------------------------------------------------------
+void test_malloc_tiny_footprint(void)
+{
+    printf("Running test_malloc_tiny_footprint...\n");
+    #define NUM_TINY 1000
+    static char *ptrs[NUM_TINY];
+    uintptr_t lo = UINTPTR_MAX;
+    uintptr_t hi = 0;
+
+    for (int i = 0; i < NUM_TINY; i++) {
+        ptrs[i] = malloc(16);
+        assert(ptrs[i] != NULL);
+        memset(ptrs[i], i & 0xFF, 16);
+        if ((uintptr_t)ptrs[i] < lo)
+            lo = (uintptr_t)ptrs[i];
+        if ((uintptr_t)ptrs[i] > hi)
+            hi = (uintptr_t)ptrs[i];
+    }
+    assert(hi - lo < (uintptr_t)NUM_TINY * 24);
+    for (int i = 0; i < NUM_TINY; i++) {
+        assert(ptrs[i][0] == (char)(i & 0xFF) && ptrs[i][15] == (char)(i & 0xFF));
+        free(ptrs[i]);
+    }
+    #undef NUM_TINY
+    printf("test_malloc_tiny_footprint passed.\n");
+}
+
 //-----------------------------------------------------------------------------
 // Test 4: Small Allocation (TINY_MAX < size <= SMALL_MAX)
 //-----------------------------------------------------------------------------
@@ -102,6 +137,36 @@ void test_malloc_very_large(void)
     printf("test_malloc_very_large passed.\n");
 }
 
+//-----------------------------------------------------------------------------
+// Test 5b: Requests too large for the address space fail with ENOMEM instead of
+// wrapping around to a small zone, through every entry point
+//-----------------------------------------------------------------------------
+void test_malloc_too_large(void)
+{
+    printf("Running test_malloc_too_large...\n");
+    size_t gaps[] = {0, 1, 8, 15, 16, 17, 24, 31, 32, 33, 48, 64, 100, 4095, 4096,
+                     4097, 8192, 65536, HUGE_PAGE_SIZE, HUGE_PAGE_SIZE + 4096};
+    char *ptr = malloc(100);
+
+    assert(ptr != NULL);
+    memset(ptr, 'k', 100);
+    for (size_t i = 0; i < sizeof(gaps) / sizeof(gaps[0]); i++) {
+        volatile size_t size = SIZE_MAX - gaps[i];
+
+        errno = 0;
+        assert(malloc(size) == NULL && errno == ENOMEM);
+        errno = 0;
+        assert(calloc(1, size) == NULL && errno == ENOMEM);
+        errno = 0;
+        assert(realloc(ptr, size) == NULL && errno == ENOMEM);
+        assert(ptr[0] == 'k' && ptr[99] == 'k');
+    }
+    errno = 0;
+    assert(malloc(SIZE_MAX / 2) == NULL && errno == ENOMEM);
+    free(ptr);
+    printf("test_malloc_too_large passed.\n");
+}
+
 //-----------------------------------------------------------------------------
 // Test 6: Multiple Allocations and Non-Overlapping Memory
 //-----------------------------------------------------------------------------
@@ -135,6 +200,159 @@ void test_malloc_multiple(void)
     #undef NUM_ALLOCS
 }
 
+//-----------------------------------------------------------------------------
+// Test 6b: Every TINY/SMALL size class, interleaved frees and refills.
+// Blocks of all classes stay intact while neighbours are freed and reused.
+//-----------------------------------------------------------------------------
+void test_malloc_size_classes(void)
+{
+    printf("Running test_malloc_size_classes...\n");
+    #define NUM_CLASSES (SMALL_MAX / 8)
+    char *ptrs[NUM_CLASSES];
+
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        ptrs[i] = malloc((size_t)(i + 1) * 8);
+        assert(ptrs[i] != NULL);
+        memset(ptrs[i], i & 0xFF, (size_t)(i + 1) * 8);
+    }
+    for (int i = 0; i < NUM_CLASSES; i += 2)
+        free(ptrs[i]);
+    for (int i = 0; i < NUM_CLASSES; i += 2) {
+        ptrs[i] = malloc((size_t)(i + 1) * 8);
+        assert(ptrs[i] != NULL);
+        memset(ptrs[i], i & 0xFF, (size_t)(i + 1) * 8);
+    }
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        for (size_t j = 0; j < (size_t)(i + 1) * 8; j++)
+            assert(ptrs[i][j] == (char)(i & 0xFF));
+        free(ptrs[i]);
+    }
+    #undef NUM_CLASSES
+    printf("test_malloc_size_classes passed.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Test 6c: A SMALL request is served from a free block of its own class that fits
+// even when the first block of the bin is too small, not from a new zone.
+// Blocks come from and go back to the arena through LARGE <-> SMALL reallocs, which
+// bypass the thread cache. Runs first, so they are carved in a row from a fresh zone.
+//-----------------------------------------------------------------------------
+#define FIT_BLOCKS  6
+#define FIT_LARGE   (1 << 20)
+
+// SMALL block of 'size' bytes carved by the arena itself.
+static char *arena_block(size_t size)
+{
+    char *ptr = realloc(malloc(FIT_LARGE), size);
+
+    assert(ptr != NULL);
+    return ptr;
+}
+
+// Sends a SMALL block back to its arena bin; returns the LARGE copy to free.
+static char *arena_release(char *ptr)
+{
+    ptr = realloc(ptr, FIT_LARGE);
+    assert(ptr != NULL);
+    return ptr;
+}
+
+void test_small_bin_first_fit(void)
+{
+    printf("Running test_small_bin_first_fit...\n");
+    size_t bin = g_config.small_bins[(600 - 1) / ALIGNMENT];
+    size_t low = 0;
+    size_t high = 0;
+    char *small[FIT_BLOCKS];
+    char *big[FIT_BLOCKS];
+    char *reused[FIT_BLOCKS];
+    char *guards[2 * FIT_BLOCKS];
+    char *large[2 * FIT_BLOCKS];
+    char *ptr;
+    size_t zones;
+
+    // The smallest and largest requests whose blocks land in the class of 600 bytes.
+    for (size_t size = g_config.tiny_max + 1; size <= g_config.small_max; size++) {
+        if (g_config.small_bins[(small_size(REQUEST_SIZE(size)) - 1) / ALIGNMENT] != bin)
+            continue;
+        low = low ? low : size;
+        high = size;
+    }
+    // A coarse SMALL alignment pads the whole class to a single block size.
+    if (small_size(REQUEST_SIZE(low)) == small_size(REQUEST_SIZE(high))) {
+        printf("test_small_bin_first_fit skipped.\n");
+        return;
+    }
+
+    // Guards in another class keep the freed blocks from coalescing.
+    for (int i = 0; i < FIT_BLOCKS; i++) {
+        big[i] = arena_block(high);
+        guards[2 * i] = arena_block(200);
+        small[i] = arena_block(low);
+        guards[2 * i + 1] = arena_block(200);
+    }
+    // Each small block lands in front of a big one in the bin.
+    for (int i = 0; i < FIT_BLOCKS; i++) {
+        large[2 * i] = arena_release(big[i]);
+        large[2 * i + 1] = arena_release(small[i]);
+    }
+    zones = ft_malloc_stats().types[SMALL].zones;
+    for (int i = 0; i < FIT_BLOCKS; i++) {
+        ptr = arena_block(high);
+        int found = 0;
+        for (int j = 0; j < FIT_BLOCKS; j++)
+            found |= ptr == big[j];
+        assert(found);
+        reused[i] = ptr;
+    }
+    assert(ft_malloc_stats().types[SMALL].zones == zones);
+
+    for (int i = 0; i < FIT_BLOCKS; i++)
+        free(reused[i]);
+    for (int i = 0; i < 2 * FIT_BLOCKS; i++) {
+        free(guards[i]);
+        free(large[i]);
+    }
+    printf("test_small_bin_first_fit passed.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Test 6d: A SMALL zone holds at least eight of the largest SMALL blocks, whatever
+// the SMALL alignment (FT_MALLOC_CONF=small_align:N) and zone size. Only the zone
+// the run starts in and the one it ends in may hold fewer of them.
+//-----------------------------------------------------------------------------
+void test_small_zone_capacity(void)
+{
+    printf("Running test_small_zone_capacity...\n");
+    #define CAPACITY_BLOCKS 64
+    char *ptrs[CAPACITY_BLOCKS];
+    size_t short_zones = 0;
+    size_t same;
+    size_t first;
+
+    for (size_t i = 0; i < CAPACITY_BLOCKS; i++) {
+        ptrs[i] = malloc(g_config.small_max);
+        assert(ptrs[i] != NULL);
+    }
+    for (size_t i = 0; i < CAPACITY_BLOCKS; i++) {
+        same = 0;
+        first = i;
+        for (size_t j = 0; j < CAPACITY_BLOCKS; j++) {
+            if (get_zone_for_ptr(ptrs[j]) != get_zone_for_ptr(ptrs[i]))
+                continue;
+            same++;
+            first = j < first ? j : first;
+        }
+        if (first == i && same < 8)
+            short_zones++;
+    }
+    assert(short_zones <= 2);
+    for (size_t i = 0; i < CAPACITY_BLOCKS; i++)
+        free(ptrs[i]);
+    #undef CAPACITY_BLOCKS
+    printf("test_small_zone_capacity passed.\n");
+}
+
 //-----------------------------------------------------------------------------
 // Test 7: Realloc Increase
 //-----------------------------------------------------------------------------
@@ -175,6 +393,65 @@ void test_realloc_decrease(void)
     printf("test_realloc_decrease passed.\n");
 }
 
+//-----------------------------------------------------------------------------
+// Test 8b: Append-style growth through every class.
+// A buffer grows 8 bytes at a time from TINY through SMALL into LARGE, then
+// doubles up to 64 MiB (mremap territory), keeping its contents at each step.
+//-----------------------------------------------------------------------------
+void test_realloc_growth(void)
+{
+    printf("Running test_realloc_growth...\n");
+    size_t len = 8;
+    char *buf = malloc(len);
+    assert(buf != NULL);
+    for (size_t i = 0; i < len; i++)
+        buf[i] = (char)('a' + i % 26);
+
+    while (len < 4096) {
+        buf = realloc(buf, len + 8);
+        assert(buf != NULL);
+        for (size_t i = 0; i < len; i++)
+            assert(buf[i] == (char)('a' + i % 26));
+        for (size_t i = len; i < len + 8; i++)
+            buf[i] = (char)('a' + i % 26);
+        len += 8;
+    }
+    char last = buf[len - 1];
+    while (len < 64 * 1024 * 1024) {
+        buf = realloc(buf, len * 2);
+        assert(buf != NULL);
+        assert(buf[0] == 'a' && buf[len - 1] == last);
+        memset(buf + len, 'z', len);
+        last = 'z';
+        len *= 2;
+    }
+    buf = realloc(buf, 100);
+    assert(buf != NULL && buf[0] == 'a' && buf[99] == (char)('a' + 99 % 26));
+    free(buf);
+    printf("test_realloc_growth passed.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Test 8c: A SMALL block grows in place into a free successor.
+//-----------------------------------------------------------------------------
+void test_realloc_in_place(void)
+{
+    printf("Running test_realloc_in_place...\n");
+    char *a = malloc(200);
+    char *b = malloc(200);
+    assert(a && b);
+    memset(a, 'I', 200);
+    free(b);
+    char *grown = realloc(a, 400);
+    assert(grown != NULL);
+    for (size_t i = 0; i < 200; i++)
+        assert(grown[i] == 'I');
+    if (getenv("FT_MALLOC_TCACHE") && getenv("FT_MALLOC_TCACHE")[0] == '0')
+        assert(grown == a);
+    free(grown);
+    printf("test_realloc_in_place passed.\n");
+}
+
 //-----------------------------------------------------------------------------
 // Test 9: Realloc with NULL pointer (should behave like malloc)
 //-----------------------------------------------------------------------------
@@ -208,6 +485,211 @@ void test_realloc_zero(void)
     printf("test_realloc_zero passed.\n");
 }
 
+//-----------------------------------------------------------------------------
+// Test 10b: calloc returns zeroed memory, even when it reuses a dirty block, and
+// rejects element counts whose product overflows.
+//-----------------------------------------------------------------------------
+void test_calloc(void)
+{
+    printf("Running test_calloc...\n");
+    size_t sizes[] = {1, 24, 64, 200, 1024, 4000, 1 << 20};
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        char *dirty = malloc(sizes[s]);
+        assert(dirty != NULL);
+        memset(dirty, 0xEE, sizes[s]);
+        free(dirty);
+        char *ptr = calloc(1, sizes[s]);
+        assert(ptr != NULL);
+        for (size_t i = 0; i < sizes[s]; i++)
+            assert(ptr[i] == 0);
+        free(ptr);
+    }
+    volatile size_t huge = SIZE_MAX / 2;
+    assert(calloc(huge, 3) == NULL);
+    printf("test_calloc passed.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Test 10c: Aligned allocations in every class honour their alignment, can be
+// written in full, resized and freed; impossible ones fail with ENOMEM.
+//-----------------------------------------------------------------------------
+void test_aligned_alloc(void)
+{
+    printf("Running test_aligned_alloc...\n");
+    size_t aligns[] = {16, 32, 64, 256, 4096, 65536, 1 << 20};
+    size_t sizes[] = {1, 40, 100, 900, 3000, 200000};
+    void *ptr;
+
+    for (size_t a = 0; a < sizeof(aligns) / sizeof(aligns[0]); a++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            assert(posix_memalign(&ptr, aligns[a], sizes[s]) == 0);
+            assert(((uintptr_t)ptr & (aligns[a] - 1)) == 0);
+            assert(malloc_usable_size(ptr) >= sizes[s]);
+            memset(ptr, 'm', sizes[s]);
+            char *grown = realloc(ptr, sizes[s] * 2);
+            assert(grown != NULL);
+            for (size_t i = 0; i < sizes[s]; i++)
+                assert(grown[i] == 'm');
+            free(grown);
+
+            ptr = aligned_alloc(aligns[a], sizes[s]);
+            assert(ptr && ((uintptr_t)ptr & (aligns[a] - 1)) == 0);
+            memset(ptr, 'a', sizes[s]);
+            free(ptr);
+        }
+    }
+    assert(posix_memalign(&ptr, 24, 16) == EINVAL);
+
+    // Requests no zone can hold fail with ENOMEM; posix_memalign() leaves errno alone.
+    size_t huge[][2] = {{64, SIZE_MAX}, {64, SIZE_MAX - 4096}, {4096, SIZE_MAX / 2},
+                        {SIZE_MAX / 2 + 1, 16}, {SIZE_MAX / 2 + 1, SIZE_MAX - 64}};
+    for (size_t h = 0; h < sizeof(huge) / sizeof(huge[0]); h++) {
+        errno = 0;
+        assert(aligned_alloc(huge[h][0], huge[h][1]) == NULL && errno == ENOMEM);
+        errno = 0;
+        assert(memalign(huge[h][0], huge[h][1]) == NULL && errno == ENOMEM);
+        errno = EBUSY;
+        assert(posix_memalign(&ptr, huge[h][0], huge[h][1]) == ENOMEM && errno == EBUSY);
+    }
+    volatile size_t too_large = SIZE_MAX - 100;
+    errno = 0;
+    assert(valloc(too_large) == NULL && errno == ENOMEM);
+
+    ptr = memalign(48, 100);
+    assert(ptr && ((uintptr_t)ptr & 63) == 0);
+    free(ptr);
+    ptr = valloc(10);
+    assert(ptr && ((uintptr_t)ptr & 4095) == 0);
+    free(ptr);
+    assert(malloc_usable_size(NULL) == 0);
+    printf("test_aligned_alloc passed.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Test 10d: Every pointer handed out is 16-byte aligned, across all classes and
+// after realloc/calloc. With FT_MALLOC_SMALL_ALIGN=64, SMALL blocks start on a
+// cache line and never share one with a neighbour.
+//-----------------------------------------------------------------------------
+void test_alignment(void)
+{
+    printf("Running test_alignment...\n");
+    const char *env = getenv("FT_MALLOC_SMALL_ALIGN");
+    size_t line = env ? (size_t)atol(env) : 16;
+    void *ptrs[300];
+
+    for (size_t i = 0; i < 300; i++) {
+        size_t size = 1 + i * 7;
+        ptrs[i] = (i % 3 == 0) ? calloc(1, size) : malloc(size);
+        assert(ptrs[i] && ((uintptr_t)ptrs[i] & 15) == 0);
+        memset(ptrs[i], 'x', size);
+        if (size > TINY_MAX_LIMIT && size <= SMALL_MAX) {
+            assert(((uintptr_t)ptrs[i] & (line - 1)) == 0);
+            assert((malloc_usable_size(ptrs[i]) + 8) % line == 0);
+        }
+    }
+    for (size_t i = 0; i < 300; i++) {
+        ptrs[i] = realloc(ptrs[i], 5 + i * 13);
+        assert(ptrs[i] && ((uintptr_t)ptrs[i] & 15) == 0);
+    }
+    for (size_t i = 0; i < 300; i++)
+        free(ptrs[i]);
+    printf("test_alignment passed.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Test 10e: Huge pages (FT_MALLOC_CONF=thp:N): LARGE zones of 2 MiB or more start
+// on a huge page boundary and keep working through realloc
+//-----------------------------------------------------------------------------
+void test_huge_pages(void)
+{
+    printf("Running test_huge_pages...\n");
+    const char *conf = getenv("FT_MALLOC_CONF");
+    int thp = conf && strstr(conf, "thp:") && strstr(conf, "thp:0") == NULL;
+    char *big = malloc(3 * HUGE_PAGE_SIZE);
+    char *small[64];
+
+    assert(big != NULL);
+    if (thp)
+        assert(((uintptr_t)big & (HUGE_PAGE_SIZE - 1)) < 4096);
+    memset(big, 'H', 3 * HUGE_PAGE_SIZE);
+    for (size_t i = 0; i < 64; i++) {
+        small[i] = malloc(200 + i * 10);
+        assert(small[i] != NULL);
+        memset(small[i], (int)i, 200 + i * 10);
+    }
+    big = realloc(big, 5 * HUGE_PAGE_SIZE);
+    assert(big != NULL);
+    for (size_t i = 0; i < 3 * HUGE_PAGE_SIZE; i += 4096)
+        assert(big[i] == 'H');
+    big = realloc(big, HUGE_PAGE_SIZE / 2);
+    assert(big != NULL && big[HUGE_PAGE_SIZE / 2 - 1] == 'H');
+    for (size_t i = 0; i < 64; i++) {
+        assert(small[i][199] == (char)i);
+        free(small[i]);
+    }
+    free(big);
+    printf("test_huge_pages passed.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Test 10f: ft_malloc_stats() and mallinfo2() follow allocations of every type
+//-----------------------------------------------------------------------------
+void test_stats(void)
+{
+    printf("Running test_stats...\n");
+    t_malloc_stats before = ft_malloc_stats();
+    t_malloc_stats live;
+    t_malloc_stats after;
+    struct mallinfo2 info;
+    void *tiny[100];
+    void *small[100];
+    void *large[3];
+
+    for (size_t i = 0; i < 100; i++) {
+        tiny[i] = malloc(16);
+        small[i] = malloc(512);
+        assert(tiny[i] && small[i]);
+    }
+    for (size_t i = 0; i < 3; i++)
+        large[i] = malloc(100000 * (i + 1));
+    live = ft_malloc_stats();
+    assert(live.types[TINY].allocs - before.types[TINY].allocs == 100);
+    assert(live.types[SMALL].allocs - before.types[SMALL].allocs == 100);
+    assert(live.types[LARGE].allocs - before.types[LARGE].allocs == 3);
+    assert(live.types[LARGE].zones - before.types[LARGE].zones == 3);
+    assert(live.types[LARGE].mapped - before.types[LARGE].mapped >= 600000);
+    assert(live.types[TINY].in_use >= 100 * 16);
+    assert(live.types[SMALL].in_use >= 100 * 512);
+    assert(live.mapped == live.in_use + live.free);
+    for (int t = 0; t < ZONE_TYPES; t++)
+        assert(live.types[t].in_use + live.types[t].free == live.types[t].mapped);
+
+    info = mallinfo2();
+    assert(info.hblks == live.types[LARGE].zones);
+    assert(info.hblkhd == live.types[LARGE].mapped);
+    assert(info.arena == live.types[TINY].mapped + live.types[SMALL].mapped);
+    assert(info.uordblks + info.fordblks == info.arena);
+
+    large[0] = realloc(large[0], 200000);
+    assert(large[0] != NULL);
+    for (size_t i = 0; i < 100; i++) {
+        free(tiny[i]);
+        free(small[i]);
+    }
+    for (size_t i = 0; i < 3; i++)
+        free(large[i]);
+    after = ft_malloc_stats();
+    assert(after.types[TINY].frees - live.types[TINY].frees == 100);
+    assert(after.types[SMALL].frees - live.types[SMALL].frees == 100);
+    assert(after.types[LARGE].frees - live.types[LARGE].frees == 3);
+    assert(after.reallocs - live.reallocs == 1);
+    assert(after.types[LARGE].zones == before.types[LARGE].zones);
+    // The thread cache keeps some of them, which still count as in use.
+    assert(after.types[SMALL].in_use <= live.types[SMALL].in_use - 50 * 512);
+    printf("test_stats passed.\n");
+}
+
 //-----------------------------------------------------------------------------
 // Test 11: show_alloc_mem Function
 //-----------------------------------------------------------------------------
@@ -241,22 +723,405 @@ void test_realloc_zero(void)
     printf("test_show_alloc_mem_hex passed.\n");
  }
 
+//-----------------------------------------------------------------------------
+// Test 12: show_alloc_mem_fd lists every zone (more than the old 128 per type) in
+// address order, allocates nothing and works from a signal handler
+//-----------------------------------------------------------------------------
+#define DUMP_LARGE 200
+
+static int g_dump_fd;
+static char g_dump[1 << 23];
+
+static void dump_on_signal(int sig)
+{
+    (void)sig;
+    show_alloc_mem_fd(g_dump_fd);
+}
+
+static size_t read_dump(void)
+{
+    ssize_t len;
+
+    assert(lseek(g_dump_fd, 0, SEEK_SET) == 0);
+    len = read(g_dump_fd, g_dump, sizeof(g_dump) - 1);
+    assert(len > 0);
+    g_dump[len] = '\0';
+    assert(ftruncate(g_dump_fd, 0) == 0 && lseek(g_dump_fd, 0, SEEK_SET) == 0);
+    return len;
+}
+
+void test_show_alloc_mem_fd(void)
+{
+    printf("Running test_show_alloc_mem_fd...\n");
+    char path[] = "/tmp/test_show_alloc_memXXXXXX";
+    void *large[DUMP_LARGE];
+    t_malloc_stats before;
+    t_malloc_stats after;
+    size_t zones = 0;
+    uintptr_t last = 0;
+    char *line;
+
+    g_dump_fd = mkstemp(path);
+    assert(g_dump_fd >= 0);
+    unlink(path);
+    for (size_t i = 0; i < DUMP_LARGE; i++)
+        assert((large[i] = malloc(SMALL_MAX_LIMIT * 2 + i)) != NULL);
+
+    before = ft_malloc_stats();
+    show_alloc_mem_fd(g_dump_fd);
+    after = ft_malloc_stats();
+    for (int t = 0; t < ZONE_TYPES; t++)
+        assert(after.types[t].allocs == before.types[t].allocs);
+    read_dump();
+    for (line = strstr(g_dump, "LARGE : "); line; line = strstr(line + 1, "LARGE : ")) {
+        uintptr_t zone = strtoull(line + 8, NULL, 16);
+        assert(zone > last);
+        last = zone;
+        zones++;
+    }
+    assert(zones >= DUMP_LARGE);
+    assert(strstr(g_dump, "Total : ") != NULL);
+
+    signal(SIGUSR1, dump_on_signal);
+    raise(SIGUSR1);
+    signal(SIGUSR1, SIG_DFL);
+    read_dump();
+    assert(strstr(g_dump, "SHOW_ALLOC_MEM") && strstr(g_dump, "Total : "));
+    show_alloc_mem_hex_fd(g_dump_fd);
+    read_dump();
+    assert(strstr(g_dump, " zone at ") != NULL && strstr(g_dump, "Block at ") != NULL);
+
+    for (size_t i = 0; i < DUMP_LARGE; i++)
+        free(large[i]);
+    close(g_dump_fd);
+    printf("test_show_alloc_mem_fd passed.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Test 12a: show_alloc_mem lists what the program holds: allocations parked in
+// the thread cache, freed or prefetched by a refill, are not listed
+//-----------------------------------------------------------------------------
+static size_t count_matches(const char *haystack, const char *needle)
+{
+    size_t count = 0;
+
+    for (const char *p = strstr(haystack, needle); p; p = strstr(p + 1, needle))
+        count++;
+    return count;
+}
+
+static size_t listed_blocks(void)
+{
+    show_alloc_mem_fd(g_dump_fd);
+    read_dump();
+    return count_matches(g_dump, " - 0x");
+}
+
+void test_show_alloc_mem_cached(void)
+{
+    printf("Running test_show_alloc_mem_cached...\n");
+    char path[] = "/tmp/test_show_alloc_memXXXXXX";
+    size_t sizes[] = {16, 48, 200, 1000};
+    size_t before;
+    void *ptrs[3];
+
+    g_dump_fd = mkstemp(path);
+    assert(g_dump_fd >= 0);
+    unlink(path);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        free(malloc(sizes[s]));
+        before = listed_blocks();
+        for (size_t i = 0; i < 3; i++) {
+            ptrs[i] = malloc(sizes[s]);
+            assert(ptrs[i] != NULL);
+            assert(listed_blocks() == before + i + 1);
+        }
+        for (size_t i = 0; i < 3; i++) {
+            free(ptrs[i]);
+            assert(listed_blocks() == before + 2 - i);
+        }
+    }
+    close(g_dump_fd);
+    printf("test_show_alloc_mem_cached passed.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Test 12b: ft_malloc_dump heap maps: JSON and binary list the same zones and
+// allocations as the text report and the hex dump, and only what the program holds
+//-----------------------------------------------------------------------------
+
+static void json_totals(size_t *allocations, size_t *bytes)
+{
+    const char *tail;
+
+    assert(ft_malloc_dump(g_dump_fd, FT_MALLOC_DUMP_JSON) == 0);
+    read_dump();
+    tail = strstr(g_dump, "],\"allocations\":");
+    assert(tail && sscanf(tail, "],\"allocations\":%zu,\"bytes\":%zu", allocations, bytes) == 2);
+}
+
+void test_heap_dump(void)
+{
+    printf("Running test_heap_dump...\n");
+    char path[] = "/tmp/test_heap_dumpXXXXXX";
+    void *ptrs[300];
+    size_t text_zones;
+    size_t text_allocs;
+    size_t allocs_before, bytes_before;
+    size_t allocs, bytes;
+    size_t expected = 0;
+    size_t len;
+    t_dump_header header;
+    t_dump_record *records;
+
+    g_dump_fd = mkstemp(path);
+    assert(g_dump_fd >= 0);
+    unlink(path);
+    json_totals(&allocs_before, &bytes_before);
+    for (size_t i = 0; i < 300; i++) {
+        assert((ptrs[i] = malloc(1 + i * 37)) != NULL);
+        expected += malloc_usable_size(ptrs[i]);
+    }
+    // Blocks of the thread cache, freed or prefetched, are not allocations.
+    json_totals(&allocs, &bytes);
+    assert(allocs == allocs_before + 300 && bytes == bytes_before + expected);
+    for (size_t i = 0; i < 300; i += 2) {
+        expected -= malloc_usable_size(ptrs[i]);
+        free(ptrs[i]);
+    }
+    json_totals(&allocs, &bytes);
+    assert(allocs == allocs_before + 150 && bytes == bytes_before + expected);
+
+    assert(ft_malloc_dump(g_dump_fd, FT_MALLOC_DUMP_TEXT) == 0);
+    read_dump();
+    text_zones = count_matches(g_dump, " : 0x");
+    text_allocs = count_matches(g_dump, " - 0x");
+    assert(text_allocs == allocs);
+
+    assert(ft_malloc_dump(g_dump_fd, FT_MALLOC_DUMP_JSON) == 0);
+    read_dump();
+    assert(strncmp(g_dump, "{\"zones\":[", 10) == 0);
+    assert(count_matches(g_dump, "\"type\":") == text_zones);
+    assert(count_matches(g_dump, "{\"addr\":") == text_allocs);
+    assert(strstr(g_dump, "\"skipped_arenas\":[]") != NULL);
+
+    assert(ft_malloc_dump(g_dump_fd, FT_MALLOC_DUMP_BINARY) == 0);
+    len = read_dump();
+    memcpy(&header, g_dump, sizeof(header));
+    assert(memcmp(header.magic, DUMP_MAGIC, 8) == 0 && header.version == DUMP_VERSION);
+    assert(header.record_size == sizeof(t_dump_record) && header.skipped_arenas == 0);
+    assert(len == sizeof(header) + header.count * sizeof(t_dump_record));
+    assert(header.count == text_zones + text_allocs);
+    records = (t_dump_record *)(g_dump + sizeof(header));
+    assert(records[0].kind == 0);
+    for (size_t i = 1; i < header.count; i++)
+        assert(records[i].type > records[i - 1].type
+               || (records[i].type == records[i - 1].type && records[i].addr > records[i - 1].addr));
+
+    show_alloc_mem_hex_fd(g_dump_fd);
+    read_dump();
+    assert(count_matches(g_dump, "Block at ") == text_allocs);
+
+    for (size_t i = 1; i < 300; i += 2)
+        free(ptrs[i]);
+    close(g_dump_fd);
+    printf("test_heap_dump passed.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Test 12c: Sampling heap profile: live bytes by call site follow allocations,
+// reallocations and frees, cumulative bytes only grow
+//-----------------------------------------------------------------------------
+#define PROFILE_ALLOCS  4000
+#define PROFILE_SIZE    1000
+
+// Sum of the byte counts ending the lines of a folded stack profile.
+static size_t folded_bytes(int format)
+{
+    size_t total = 0;
+    char *line;
+    char *space;
+
+    assert(ft_malloc_prof_dump(g_dump_fd, format) == 0);
+    if (lseek(g_dump_fd, 0, SEEK_CUR) == 0)
+        return 0;
+    read_dump();
+    for (line = strtok(g_dump, "\n"); line; line = strtok(NULL, "\n")) {
+        space = strrchr(line, ' ');
+        assert(space != NULL);
+        total += strtoul(space + 1, NULL, 10);
+    }
+    return total;
+}
+
+__attribute__((noinline))
+static void profile_site(void **ptrs)
+{
+    for (size_t i = 0; i < PROFILE_ALLOCS; i++)
+        assert((ptrs[i] = malloc(PROFILE_SIZE)) != NULL);
+}
+
+void test_heap_profile(void)
+{
+    printf("Running test_heap_profile...\n");
+    char path[] = "/tmp/test_heap_profileXXXXXX";
+    static void *ptrs[PROFILE_ALLOCS];
+    size_t expected = PROFILE_ALLOCS * PROFILE_SIZE;
+    size_t live_before;
+    size_t alloc_before;
+    size_t live;
+    size_t alloc;
+
+    g_dump_fd = mkstemp(path);
+    assert(g_dump_fd >= 0);
+    unlink(path);
+    if (!g_config.prof_sample) {
+        assert(ft_malloc_prof_dump(g_dump_fd, FT_MALLOC_PROF_PPROF) == -1);
+        close(g_dump_fd);
+        printf("test_heap_profile passed (profiling off).\n");
+        return;
+    }
+    live_before = folded_bytes(FT_MALLOC_PROF_FOLDED_LIVE);
+    alloc_before = folded_bytes(FT_MALLOC_PROF_FOLDED_ALLOC);
+    profile_site(ptrs);
+
+    // One sample every prof_sample bytes on average: the estimate is within a few
+    // percent over 4 MB; allow for much more.
+    live = folded_bytes(FT_MALLOC_PROF_FOLDED_LIVE) - live_before;
+    alloc = folded_bytes(FT_MALLOC_PROF_FOLDED_ALLOC) - alloc_before;
+    assert(live > expected / 2 && live < expected * 2);
+    assert(alloc == live);
+
+    assert(ft_malloc_prof_dump(g_dump_fd, FT_MALLOC_PROF_PPROF) == 0);
+    read_dump();
+    assert(strncmp(g_dump, "heap profile: ", 14) == 0);
+    assert(strstr(g_dump, "] @ heapprofile\n") != NULL);
+    assert(strstr(g_dump, "] @ 0x") != NULL);
+    assert(strstr(g_dump, "\nMAPPED_LIBRARIES:\n") != NULL);
+
+    // A failed realloc keeps the sample, a successful one profiles the result instead.
+    for (size_t i = 0; i < PROFILE_ALLOCS; i++)
+        assert(realloc(ptrs[i], SIZE_MAX / 2) == NULL);
+    assert(folded_bytes(FT_MALLOC_PROF_FOLDED_LIVE) - live_before == live);
+    for (size_t i = 0; i < PROFILE_ALLOCS; i++)
+        assert((ptrs[i] = realloc(ptrs[i], 2 * PROFILE_SIZE)) != NULL);
+    live = folded_bytes(FT_MALLOC_PROF_FOLDED_LIVE) - live_before;
+    alloc = folded_bytes(FT_MALLOC_PROF_FOLDED_ALLOC) - alloc_before;
+    assert(live > expected && live < expected * 4);
+
+    for (size_t i = 0; i < PROFILE_ALLOCS; i++)
+        free(ptrs[i]);
+    assert(folded_bytes(FT_MALLOC_PROF_FOLDED_LIVE) == live_before);
+    assert(folded_bytes(FT_MALLOC_PROF_FOLDED_ALLOC) - alloc_before == alloc);
+    close(g_dump_fd);
+    printf("test_heap_profile passed.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Test 12d: Leak report: live allocations are counted by size class, freed ones
+// are not (even while cached), and the report is written at exit when asked to
+//-----------------------------------------------------------------------------
+#define LEAK_SMALL  50
+#define LEAK_LARGE  3
+
+static void leak_totals(size_t *count, size_t *bytes)
+{
+    assert(ft_malloc_leak_report(g_dump_fd) == 0);
+    read_dump();
+    assert(sscanf(g_dump, "ft_malloc: %zu live allocations, %zu bytes", count, bytes) == 2);
+}
+
+void test_leak_report(void)
+{
+    printf("Running test_leak_report...\n");
+    char path[] = "/tmp/test_leak_reportXXXXXX";
+    void *ptrs[LEAK_SMALL + LEAK_LARGE];
+    size_t count_before, bytes_before;
+    size_t count, bytes;
+    size_t expected = 0;
+    int pipefd[2];
+    int status;
+    ssize_t len;
+    pid_t pid;
+
+    g_dump_fd = mkstemp(path);
+    assert(g_dump_fd >= 0);
+    unlink(path);
+    leak_totals(&count_before, &bytes_before);
+    for (size_t i = 0; i < LEAK_SMALL + LEAK_LARGE; i++) {
+        ptrs[i] = malloc(i < LEAK_SMALL ? 100 : SMALL_MAX_LIMIT * 4);
+        assert(ptrs[i] != NULL);
+        expected += malloc_usable_size(ptrs[i]);
+    }
+    leak_totals(&count, &bytes);
+    assert(count - count_before == LEAK_SMALL + LEAK_LARGE);
+    assert(bytes - bytes_before == expected);
+    assert(strstr(g_dump, "\n  SMALL up to ") != NULL);
+    assert(strstr(g_dump, "\n  LARGE up to ") != NULL);
+    if (g_config.prof_sample)
+        assert(strstr(g_dump, "\nlive bytes by allocation site") != NULL);
+    for (size_t i = 0; i < LEAK_SMALL + LEAK_LARGE; i++)
+        free(ptrs[i]);
+    leak_totals(&count, &bytes);
+    assert(count == count_before && bytes == bytes_before);
+
+    // The at-exit report, from a child that leaks one block.
+    assert(pipe(pipefd) == 0);
+    fflush(stdout);
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        close(pipefd[0]);
+        g_config.leak_report = pipefd[1];
+        ptrs[0] = malloc(1000);
+        exit(ptrs[0] ? 0 : 1);
+    }
+    close(pipefd[1]);
+    len = 0;
+    for (ssize_t n; (n = read(pipefd[0], g_dump + len, sizeof(g_dump) - 1 - len)) > 0;)
+        len += n;
+    g_dump[len] = '\0';
+    close(pipefd[0]);
+    assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(strncmp(g_dump, "ft_malloc: ", 11) == 0);
+    assert(strstr(g_dump, "\n  SMALL up to 1024 bytes: ") != NULL);
+    close(g_dump_fd);
+    printf("test_leak_report passed.\n");
+}
+
 //-----------------------------------------------------------------------------
 // Main: Run All Tests
 //-----------------------------------------------------------------------------
 int main(void)
 {
+    test_small_bin_first_fit();
+    test_small_zone_capacity();
     test_malloc_tiny();
     test_malloc_tiny_boundary();
+    test_malloc_tiny_footprint();
     test_malloc_small();
     test_malloc_large();
     test_malloc_very_large();
+    test_malloc_too_large();
     test_malloc_multiple();
+    test_malloc_size_classes();
     test_realloc_increase();
     test_realloc_decrease();
+    test_realloc_growth();
+    test_realloc_in_place();
     test_realloc_null();
     test_realloc_zero();
+    test_calloc();
+    test_aligned_alloc();
+    test_alignment();
+    test_huge_pages();
+    test_stats();
     test_show_alloc_mem();
+    test_show_alloc_mem_fd();
+    test_show_alloc_mem_cached();
+    test_heap_dump();
+    test_heap_profile();
+    test_leak_report();
     printf("All malloc tests passed successfully.\n");
     return 0;
 }
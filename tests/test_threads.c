@@ -2,11 +2,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
 #include "libft_malloc.h"
 
 #define NUM_THREADS 10
 #define NUM_ITERATIONS 1000
 
+#define REALLOC_THREADS      8
+#define REALLOC_ITERATIONS   20000
+#define REALLOC_SLOTS        16
+#define REALLOC_MAX_SIZE     8192
+
+#define XFREE_THREADS        4
+#define XFREE_BLOCKS         2000
+
+#define PIPE_ITEMS           50000
+#define PIPE_RING            256
+
+#define FORK_THREADS         4
+#define FORK_CHILDREN        50
+#define FORK_CHILD_TIMEOUT   10
+
+#define BENCH_OPS_PER_THREAD 50000
+#define BENCH_LIVE_SLOTS     64
+#define BENCH_MAX_THREADS    16
+
 void *thread_func() {
     for (int i = 0; i < NUM_ITERATIONS; i++) {
         int op = rand() % 3;
@@ -43,6 +66,347 @@ void *thread_func() {
     return NULL;
 }
 
+//-----------------------------------------------------------------------------
+// Realloc stress test: every thread resizes its own buffers across the TINY,
+// SMALL and LARGE classes while the others do the same in shared zones, and
+// checks after each call that the preserved prefix still holds its pattern.
+//-----------------------------------------------------------------------------
+static char pattern_byte(size_t tag, size_t i)
+{
+    return (char)((tag * 31 + i) & 0xFF);
+}
+
+void *realloc_thread_func(void *arg) {
+    char *bufs[REALLOC_SLOTS] = {0};
+    size_t sizes[REALLOC_SLOTS] = {0};
+    unsigned int seed = (unsigned int)(size_t)arg;
+    size_t tag_base = (size_t)arg * REALLOC_SLOTS;
+
+    for (int i = 0; i < REALLOC_ITERATIONS; i++) {
+        int idx = rand_r(&seed) % REALLOC_SLOTS;
+        size_t tag = tag_base + idx;
+        size_t new_size = (rand_r(&seed) % REALLOC_MAX_SIZE) + 1;
+        char *buf = realloc(bufs[idx], new_size);
+        if (!buf) {
+            fprintf(stderr, "realloc(%zu) failed\n", new_size);
+            exit(EXIT_FAILURE);
+        }
+        size_t kept = sizes[idx] < new_size ? sizes[idx] : new_size;
+        for (size_t j = 0; j < kept; j++) {
+            if (buf[j] != pattern_byte(tag, j)) {
+                fprintf(stderr, "realloc corrupted byte %zu of slot %zu\n", j, tag);
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (size_t j = kept; j < new_size; j++)
+            buf[j] = pattern_byte(tag, j);
+        bufs[idx] = buf;
+        sizes[idx] = new_size;
+    }
+    for (int i = 0; i < REALLOC_SLOTS; i++)
+        free(bufs[i]);
+    return NULL;
+}
+
+void run_realloc_stress(void) {
+    pthread_t threads[REALLOC_THREADS];
+
+    for (int i = 0; i < REALLOC_THREADS; i++) {
+        if (pthread_create(&threads[i], NULL, realloc_thread_func,
+                           (void *)(size_t)(i + 1)) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < REALLOC_THREADS; i++)
+        pthread_join(threads[i], NULL);
+    printf("Realloc stress test completed successfully.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Cross-thread free test: worker threads allocate blocks of every class and exit;
+// the main thread checks and frees them all. With FT_MALLOC_ARENAS > 1 the
+// workers allocate from other arenas than the main thread, so every free must be
+// routed back to the arena owning the block. The workers' allocation counts must
+// survive their exit in ft_malloc_stats().
+//-----------------------------------------------------------------------------
+void *xfree_thread_func(void *arg) {
+    char **blocks = arg;
+    unsigned int seed = (unsigned int)(size_t)blocks;
+
+    for (int i = 0; i < XFREE_BLOCKS; i++) {
+        size_t size = (rand_r(&seed) % 3 == 0) ? (size_t)(2000 + i) : (size_t)(i % 900) + 1;
+        blocks[i] = malloc(size);
+        if (!blocks[i]) {
+            fprintf(stderr, "malloc(%zu) failed\n", size);
+            exit(EXIT_FAILURE);
+        }
+        blocks[i][0] = (char)i;
+    }
+    return NULL;
+}
+
+static size_t stats_total(const t_malloc_stats *stats, int frees) {
+    size_t total = 0;
+
+    for (int t = 0; t < ZONE_TYPES; t++)
+        total += frees ? stats->types[t].frees : stats->types[t].allocs;
+    return total;
+}
+
+void run_cross_thread_free(void) {
+    static char *blocks[XFREE_THREADS][XFREE_BLOCKS];
+    pthread_t threads[XFREE_THREADS];
+    t_malloc_stats before = ft_malloc_stats();
+    t_malloc_stats after;
+
+    for (int i = 0; i < XFREE_THREADS; i++) {
+        if (pthread_create(&threads[i], NULL, xfree_thread_func, blocks[i]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < XFREE_THREADS; i++)
+        pthread_join(threads[i], NULL);
+    after = ft_malloc_stats();
+    if (stats_total(&after, 0) - stats_total(&before, 0) < XFREE_THREADS * XFREE_BLOCKS) {
+        fprintf(stderr, "allocations of exited threads missing from the stats\n");
+        exit(EXIT_FAILURE);
+    }
+    before = after;
+    for (int i = 0; i < XFREE_THREADS; i++) {
+        for (int j = 0; j < XFREE_BLOCKS; j++) {
+            if (blocks[i][j][0] != (char)j) {
+                fprintf(stderr, "block %d of thread %d corrupted\n", j, i);
+                exit(EXIT_FAILURE);
+            }
+            free(blocks[i][j]);
+        }
+    }
+    after = ft_malloc_stats();
+    if (stats_total(&after, 1) - stats_total(&before, 1) < XFREE_THREADS * XFREE_BLOCKS
+        || after.types[LARGE].mapped >= before.types[LARGE].mapped) {
+        fprintf(stderr, "frees missing from the stats\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("Cross-thread free test completed successfully.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Pipeline test: a producer allocates buffers of every class while a consumer
+// frees them concurrently. With several arenas the consumer's frees land in the
+// producer's arena while it is allocating, which exercises the remote-free stack
+// and its draining; buffer contents are checked before each free.
+//-----------------------------------------------------------------------------
+typedef struct s_pipe {
+    char            *items[PIPE_RING];
+    size_t          sizes[PIPE_RING];
+    size_t          head;
+    size_t          tail;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+} t_pipe;
+
+void *pipe_producer(void *arg) {
+    t_pipe *pipe = arg;
+    unsigned int seed = 7;
+
+    for (size_t i = 0; i < PIPE_ITEMS; i++) {
+        size_t size = (i % 64 == 0) ? (size_t)(4096 + rand_r(&seed) % 4096)
+                                    : (size_t)rand_r(&seed) % SMALL_MAX + 1;
+        char *buf = malloc(size);
+        if (!buf) {
+            fprintf(stderr, "malloc(%zu) failed\n", size);
+            exit(EXIT_FAILURE);
+        }
+        memset(buf, (char)i, size);
+        pthread_mutex_lock(&pipe->lock);
+        while (pipe->head - pipe->tail == PIPE_RING)
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        pipe->items[pipe->head % PIPE_RING] = buf;
+        pipe->sizes[pipe->head % PIPE_RING] = size;
+        pipe->head++;
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+    return NULL;
+}
+
+void *pipe_consumer(void *arg) {
+    t_pipe *pipe = arg;
+
+    for (size_t i = 0; i < PIPE_ITEMS; i++) {
+        pthread_mutex_lock(&pipe->lock);
+        while (pipe->head == pipe->tail)
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        char *buf = pipe->items[pipe->tail % PIPE_RING];
+        size_t size = pipe->sizes[pipe->tail % PIPE_RING];
+        pipe->tail++;
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+        if (buf[0] != (char)i || buf[size - 1] != (char)i) {
+            fprintf(stderr, "pipeline buffer %zu corrupted\n", i);
+            exit(EXIT_FAILURE);
+        }
+        free(buf);
+    }
+    return NULL;
+}
+
+void run_pipeline(void) {
+    static t_pipe pipe = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER
+    };
+    pthread_t producer, consumer;
+
+    if (pthread_create(&producer, NULL, pipe_producer, &pipe) != 0
+        || pthread_create(&consumer, NULL, pipe_consumer, &pipe) != 0) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    printf("Pipeline test completed successfully.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Fork test: worker threads allocate and free blocks of every class without pause
+// while the main thread forks. Each child must be able to allocate, free, read the
+// statistics and report the heap although the workers held allocator locks when it
+// was forked; a child that deadlocks is killed by its alarm and fails the test.
+//-----------------------------------------------------------------------------
+static int g_fork_stop;
+
+void *fork_worker(void *arg) {
+    unsigned int seed = (unsigned int)(uintptr_t)arg;
+    char *slots[16] = {NULL};
+
+    while (!__atomic_load_n(&g_fork_stop, __ATOMIC_RELAXED)) {
+        size_t slot = rand_r(&seed) % 16;
+        size_t size = (rand_r(&seed) % 8 == 0) ? (size_t)(SMALL_MAX + rand_r(&seed) % 65536)
+                                                : (size_t)rand_r(&seed) % SMALL_MAX + 1;
+        free(slots[slot]);
+        slots[slot] = malloc(size);
+        if (slots[slot])
+            memset(slots[slot], 0x5A, size);
+    }
+    for (size_t i = 0; i < 16; i++)
+        free(slots[i]);
+    return NULL;
+}
+
+static void fork_child(void) {
+    t_malloc_stats stats;
+    char *ptrs[64];
+    int fd;
+
+    alarm(FORK_CHILD_TIMEOUT);
+    for (size_t i = 0; i < 64; i++) {
+        size_t size = (i % 8 == 7) ? (size_t)(SMALL_MAX + i * 1000) : i * 37 + 1;
+        ptrs[i] = malloc(size);
+        if (!ptrs[i])
+            _exit(2);
+        memset(ptrs[i], (int)i, size);
+    }
+    for (size_t i = 0; i < 64; i++) {
+        if (ptrs[i][0] != (char)i)
+            _exit(3);
+        free(ptrs[i]);
+    }
+    stats = ft_malloc_stats();
+    if (stats_total(&stats, 0) < 64)
+        _exit(4);
+    fd = open("/dev/null", O_WRONLY);
+    if (fd < 0 || ft_malloc_dump(fd, FT_MALLOC_DUMP_TEXT) != 0)
+        _exit(5);
+    _exit(0);
+}
+
+void run_fork(void) {
+    pthread_t threads[FORK_THREADS];
+    int status;
+    pid_t pid;
+
+    g_fork_stop = 0;
+    for (int i = 0; i < FORK_THREADS; i++) {
+        if (pthread_create(&threads[i], NULL, fork_worker, (void *)(uintptr_t)(i + 1)) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < FORK_CHILDREN; i++) {
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+            fork_child();
+        if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "fork child %d failed (status %#x)\n", i, status);
+            exit(EXIT_FAILURE);
+        }
+        usleep(1000);
+    }
+    __atomic_store_n(&g_fork_stop, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < FORK_THREADS; i++)
+        pthread_join(threads[i], NULL);
+    printf("Fork test completed successfully.\n");
+}
+
+//-----------------------------------------------------------------------------
+// Scaling benchmark: each thread keeps a small working set of TINY/SMALL blocks
+// and replaces a random one per operation, so every op is a free + malloc pair.
+// Run with FT_MALLOC_TCACHE=0 to measure the allocator without the thread cache.
+//-----------------------------------------------------------------------------
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void *bench_thread_func(void *arg) {
+    void *slots[BENCH_LIVE_SLOTS] = {0};
+    unsigned int seed = (unsigned int)(size_t)arg;
+
+    for (int i = 0; i < BENCH_OPS_PER_THREAD; i++) {
+        int idx = rand_r(&seed) % BENCH_LIVE_SLOTS;
+        size_t size = (rand_r(&seed) % SMALL_MAX) + 1;
+        free(slots[idx]);
+        slots[idx] = malloc(size);
+        if (slots[idx])
+            ((char *)slots[idx])[0] = (char)i;
+    }
+    for (int i = 0; i < BENCH_LIVE_SLOTS; i++)
+        free(slots[i]);
+    return NULL;
+}
+
+void run_scaling_benchmark(void) {
+    pthread_t threads[BENCH_MAX_THREADS];
+    const char *env = getenv("FT_MALLOC_TCACHE");
+
+    printf("Scaling benchmark (thread cache %s):\n",
+           (env && env[0] == '0') ? "off" : "on");
+    for (int count = 1; count <= BENCH_MAX_THREADS; count *= 2) {
+        double start = now_sec();
+        for (int i = 0; i < count; i++) {
+            if (pthread_create(&threads[i], NULL, bench_thread_func,
+                               (void *)(size_t)(i + 1)) != 0) {
+                perror("pthread_create");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (int i = 0; i < count; i++)
+            pthread_join(threads[i], NULL);
+        double elapsed = now_sec() - start;
+        printf("%3d threads: %12.0f ops/sec\n", count,
+               (double)count * BENCH_OPS_PER_THREAD / elapsed);
+    }
+}
+
 int main(void) {
     pthread_t threads[NUM_THREADS];
 
@@ -61,5 +425,11 @@ int main(void) {
 
     printf("Multithreaded test completed successfully.\n");
 
+    run_realloc_stress();
+    run_cross_thread_free();
+    run_pipeline();
+    run_fork();
+    run_scaling_benchmark();
+
     return 0;
 }